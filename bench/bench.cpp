@@ -0,0 +1,453 @@
+// Self-contained micro benchmarks for registration, Parser::parse,
+// Parser::print_help and Parser::print_completion on synthetic schemas.
+//
+// Every measurement is written as one JSON object per line (to stdout or the
+// file given with --out) such that results of different releases can be
+// compared mechanically. A human readable summary goes to stderr.
+#include "batch.h"
+#include "count_allocations.h"
+#include "flat_parser.h"
+#include "parser.h"
+#include "v_opt.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory_resource>
+#include <optional>
+#include <spawn.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+struct Measurement {
+  double ns{0};
+  std::size_t allocs{0};
+  std::size_t bytes{0};
+};
+
+// runs setup (untimed) and func (timed) reps times, keeps the fastest run
+template <typename SETUP, typename FUNC>
+Measurement measure(int reps, SETUP&& setup, FUNC&& func) {
+  Measurement best;
+  for (int rep = 0; rep < reps; ++rep) {
+    auto state = setup();
+    // of this thread, see count_allocations.h
+    auto allocs = parse_stats_detail::allocations;
+    auto bytes = parse_stats_detail::allocated_bytes;
+    auto start = bench_clock::now();
+    func(*state);
+    auto stop = bench_clock::now();
+    Measurement m{std::chrono::duration<double, std::nano>(stop - start).count(),
+                  parse_stats_detail::allocations - allocs, parse_stats_detail::allocated_bytes - bytes};
+    if (rep == 0 || m.ns < best.ns) {
+      best = m;
+    }
+  }
+  return best;
+}
+
+long peak_rss_kb() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+constexpr std::string_view bench_choices[] = {"alpha", "beta", "gamma"};
+constexpr std::string_view bench_descriptions[] = {"first", "second", "third"};
+
+// the argument kinds a synthetic schema cycles through, together with a value
+// each of them accepts and the closest FlatParser descriptor
+struct Kind {
+  std::string_view name;
+  std::function<void(Parser&, const std::string&)> add;
+  std::string_view value;
+  StaticArg (*flat)(std::string_view);
+};
+
+const std::vector<Kind>& kinds() {
+  static const std::vector<Kind> all{
+      {"IntArg", [](Parser& p, const std::string& n) { (void)p.addArg<IntArg>(n, 0, "N", "an integer"); }, "42",
+       [](std::string_view n) { return StaticArg::Int(n, 0, "N", "an integer"); }},
+      {"StringArg", [](Parser& p, const std::string& n) { (void)p.addArg<StringArg>(n, "", "S", "a string"); }, "some-value",
+       [](std::string_view n) { return StaticArg::String(n, "", "S", "a string"); }},
+      {"StringViewArg", [](Parser& p, const std::string& n) { (void)p.addArg<StringViewArg>(n, "", "S", "a string view"); }, "some-value",
+       [](std::string_view n) { return StaticArg::String(n, "", "S", "a string view"); }},
+      {"StringChoiceArg", [](Parser& p, const std::string& n) {
+         (void)p.addArg<StringChoiceArg>(n, "alpha", "C", "a choice", std::initializer_list<std::string>{"alpha", "beta", "gamma"},
+                                         std::initializer_list<std::string>{"first", "second", "third"}); }, "gamma",
+       [](std::string_view n) { return StaticArg::StringChoice(n, "alpha", "C", "a choice", bench_choices, bench_descriptions); }},
+      {"FileArg", [](Parser& p, const std::string& n) { (void)p.addArg<FileArg>(n, "", "F", "a file", std::string_view{"*.cpp"}); }, "src/parser.cpp",
+       [](std::string_view n) { return StaticArg::File(n, "", "F", "a file", "*.cpp"); }},
+      {"DirectoryArg", [](Parser& p, const std::string& n) { (void)p.addArg<DirectoryArg>(n, ".", "D", "a directory"); }, "include",
+       [](std::string_view n) { return StaticArg::Directory(n, ".", "D", "a directory"); }},
+      {"SwitchArg", [](Parser& p, const std::string& n) { (void)p.addArg<SwitchArg>(n, false, "", "a switch"); }, "",
+       [](std::string_view n) { return StaticArg::Switch(n, "a switch"); }},
+      {"VectorArg<IntArg>", [](Parser& p, const std::string& n) { (void)p.addArg<VectorArg<IntArg>>(n, 0, "N", "integers"); }, "7",
+       [](std::string_view n) { return StaticArg::Int(n, 0, "N", "integers").vector(); }},
+      {"DoubleArg", [](Parser& p, const std::string& n) { (void)p.addArg<DoubleArg>(n, 1.0, "X", "a number"); }, "2.5",
+       [](std::string_view n) { return StaticArg::String(n, "1.0", "X", "a number"); }},
+      {"VectorArg<UIntArg>", [](Parser& p, const std::string& n) { (void)p.addArg<VectorArg<UIntArg>>(n, 0, "IDS", "id lists"); }, "1-4,9",
+       [](std::string_view n) { return StaticArg::String(n, "", "IDS", "id lists").vector(); }},
+      {"VectorArg<StringArg>", [](Parser& p, const std::string& n) { (void)p.addArg<VectorArg<StringArg>>(n, "", "S", "strings"); }, "v",
+       [](std::string_view n) { return StaticArg::String(n, "", "S", "strings").vector(); }},
+  };
+  return all;
+}
+
+std::string option_name(std::size_t i) {
+  return fmt::format("--option-{}", i);
+}
+
+// builds a parser with n_options flags plus an overflow argument of kind
+// "file", "file-view" or "ids"
+std::unique_ptr<Parser> make_parser(std::size_t n_options, std::string_view overflow,
+                                    std::pmr::memory_resource* resource = std::pmr::get_default_resource()) {
+  auto p = std::make_unique<Parser>(resource);
+  for (std::size_t i = 0; i < n_options; ++i) {
+    kinds()[i % kinds().size()].add(*p, option_name(i));
+  }
+  if (overflow == "file-view") {
+    (void)p->addOther<FileViewArg>("FILE", "input files", std::string_view{"*.cpp"});
+  } else if (overflow == "ids") {
+    (void)p->addOther<UIntArg>("ID", "input ids");
+  } else {
+    (void)p->addOther<FileArg>("FILE", "input files", std::string_view{"*.cpp"});
+  }
+  return p;
+}
+
+// FlatParser does not copy names, they have to outlive it like literals would
+const std::vector<std::string>& option_names(std::size_t n_options) {
+  static std::vector<std::string> names;
+  while (names.size() < n_options) {
+    names.push_back(option_name(names.size()));
+  }
+  return names;
+}
+
+// a FlatParser with the same schema as make_parser, all in one arena
+struct FlatState {
+  explicit FlatState(std::size_t n_options) : buffer(64 * 1024 + n_options * 256), arena{buffer.data(), buffer.size()} {}
+  std::vector<std::byte> buffer;
+  std::pmr::monotonic_buffer_resource arena;
+  std::optional<FlatParser> parser;
+};
+
+void make_flat_parser(FlatState& state, std::size_t n_options) {
+  const auto& names = option_names(n_options);
+  auto& p = state.parser.emplace(&state.arena);
+  p.reserve(n_options + 1);
+  for (std::size_t i = 0; i < n_options; ++i) {
+    p.add(kinds()[i % kinds().size()].flat(names[i]));
+  }
+  p.add(StaticArg::File("FILE", "", "FILE", "input files", "*.cpp").others());
+}
+
+// an argv with n_tokens entries after argv[0]
+class Argv {
+  public:
+    Argv(std::string_view workload, std::size_t n_options, std::size_t n_tokens) {
+      m_storage.reserve(n_tokens + 1);
+      m_storage.emplace_back("tabparse_bench_app");
+      if (workload == "flags") {
+        // cycle through all options, with values where they take one
+        for (std::size_t i = 0;; ++i) {
+          const auto& kind = kinds()[(i % n_options) % kinds().size()];
+          std::size_t needed = kind.value.empty() ? 1 : 2;
+          if (m_storage.size() + needed > n_tokens + 1) {
+            break;
+          }
+          m_storage.push_back(option_name(i % n_options));
+          if (!kind.value.empty()) {
+            m_storage.emplace_back(kind.value);
+          }
+        }
+        // pad with a value for the overflow argument
+        while (m_storage.size() <= n_tokens) {
+          m_storage.emplace_back("trailing/overflow.cpp");
+        }
+      } else if (workload == "ids") {
+        // ten digit ids, as they come out of a database
+        for (std::size_t i = 0; i < n_tokens; ++i) {
+          m_storage.push_back(fmt::format("{}", 4000000000 + i * 7919));
+        }
+      } else {
+        for (std::size_t i = 0; i < n_tokens; ++i) {
+          m_storage.push_back(fmt::format("some/directory/file_{}.cpp", i));
+        }
+      }
+      for (auto& s : m_storage) {
+        m_pointers.push_back(s.data());
+      }
+      m_pointers.push_back(nullptr);
+    }
+    int argc() const { return int(m_pointers.size() - 1); }
+    char** argv() { return m_pointers.data(); }
+  private:
+    std::vector<std::string> m_storage;
+    std::vector<char*> m_pointers;
+};
+
+// a parser whose values all come from one arena
+struct ArenaParser {
+  std::pmr::monotonic_buffer_resource arena;
+  std::unique_ptr<Parser> parser;
+};
+
+// the help is printed to stdout, which we don't want to see in the results
+class SilenceStdout {
+  public:
+    SilenceStdout() {
+      std::cout.flush();
+      std::fflush(stdout);
+      m_saved = dup(STDOUT_FILENO);
+      int devnull = open("/dev/null", O_WRONLY);
+      dup2(devnull, STDOUT_FILENO);
+      close(devnull);
+    }
+    ~SilenceStdout() {
+      std::cout.flush();
+      std::fflush(stdout);
+      dup2(m_saved, STDOUT_FILENO);
+      close(m_saved);
+    }
+  private:
+    int m_saved;
+};
+
+// what a dynamic completion may cost at most before TAB feels sluggish
+constexpr double tab_budget_ns = 5e6;
+
+// runs this binary as the program being completed (see the start of main),
+// such that process startup and dynamic linking are part of the measurement
+void spawn_completion(std::size_t n_options, std::string_view word) {
+  constexpr std::string_view variable = "TABPARSE_BENCH_OPTIONS=";
+  std::string options = fmt::format("{}{}", variable, n_options);
+  std::string current{word};
+  char name[] = "tabparse_bench";
+  char keyword[] = "__tabparse_complete";
+  char position[] = "2";
+  char* child_argv[] = {name, keyword, position, name, current.data(), nullptr};
+  // the environment of the bench (LD_LIBRARY_PATH of a shared build, ...)
+  // with the number of options replaced
+  std::vector<char*> child_env;
+  for (char** entry = environ; *entry; ++entry) {
+    if (std::string_view{*entry}.substr(0, variable.size()) != variable) {
+      child_env.push_back(*entry);
+    }
+  }
+  child_env.push_back(options.data());
+  child_env.push_back(nullptr);
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+  pid_t pid;
+  int status = 0;
+  if (posix_spawn(&pid, "/proc/self/exe", &actions, nullptr, child_argv, child_env.data()) != 0 ||
+      waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    posix_spawn_file_actions_destroy(&actions);
+    throw std::runtime_error("the completion request did not succeed.");
+  }
+  posix_spawn_file_actions_destroy(&actions);
+}
+
+class Reporter {
+  public:
+    explicit Reporter(const std::string& path) {
+      if (!path.empty()) {
+        m_out = std::fopen(path.c_str(), "w");
+        if (!m_out) {
+          throw std::invalid_argument(fmt::format("could not open {} for writing.", path));
+        }
+      }
+    }
+    ~Reporter() {
+      if (m_out != stdout) {
+        std::fclose(m_out);
+      }
+    }
+    void report(std::string_view bench, std::string_view workload, std::size_t n_options,
+                std::size_t n_tokens, const Measurement& m) {
+      // only parsing has a meaningful per token cost
+      std::string per_token = n_tokens ? fmt::format("{:.2f}", m.ns / double(n_tokens)) : "null";
+      fmt::print(m_out,
+                 "{{\"bench\":\"{}\",\"workload\":\"{}\",\"options\":{},\"tokens\":{},"
+                 "\"ns\":{:.0f},\"ns_per_token\":{},\"allocs\":{},\"bytes\":{},\"peak_rss_kb\":{}}}\n",
+                 bench, workload, n_options, n_tokens, m.ns, per_token, m.allocs, m.bytes, peak_rss_kb());
+      std::fflush(m_out);
+      fmt::print(stderr, "{:<12} {:<14} {:>6} options {:>8} tokens {:>12.1f} us {:>8} ns/token {:>8} allocs\n",
+                 bench, workload, n_options, n_tokens, m.ns / 1000., n_tokens ? per_token : "-", m.allocs);
+    }
+  private:
+    std::FILE* m_out{stdout};
+};
+}
+
+int main(int argc, char** argv) {
+  // the fast path a program with a costly startup would take: only register
+  // the arguments, the parser answers and exits
+  if (Parser::completion_request(argc, argv)) {
+    const char* n_options = std::getenv("TABPARSE_BENCH_OPTIONS");
+    make_parser(n_options ? std::strtoul(n_options, nullptr, 10) : 0, "file")->parse(argc, argv);
+  }
+  Parser cli;
+  auto& out = cli.addArg<FileArg>("--out", "", "FILE", "write the JSON lines to FILE instead of stdout", std::string_view{"*.json"})->ref();
+  auto& quick = cli.addArg<SwitchArg>("--quick", false, "", "only run the small configurations")->ref();
+  cli.parse(argc, argv);
+
+  std::vector<std::size_t> option_counts{10, 100, 1000, 5000};
+  std::vector<std::size_t> token_counts{1000, 10000, 100000, 1000000};
+  if (quick) {
+    option_counts = {10, 100};
+    token_counts = {1000, 10000};
+  }
+  Reporter reporter{out};
+
+  char tmpdir[] = "/tmp/tabparse_bench_XXXXXX";
+  if (!mkdtemp(tmpdir) || chdir(tmpdir) != 0) {
+    throw std::runtime_error("could not create a scratch directory for the completion files.");
+  }
+
+  for (auto n_options : option_counts) {
+    auto reg = measure(5, [] { return std::make_unique<int>(0); },
+                       [n_options](int&) { auto p = make_parser(n_options, "file"); });
+    reporter.report("register", "all-kinds", n_options, 0, reg);
+    (void)option_names(n_options);
+    auto flat_reg = measure(5, [n_options] { return std::make_unique<FlatState>(n_options); },
+                            [n_options](FlatState& state) { make_flat_parser(state, n_options); });
+    reporter.report("register", "flat", n_options, 0, flat_reg);
+
+    for (std::string_view workload : {"flags", "overflow", "overflow-view", "ids"}) {
+      for (auto n_tokens : token_counts) {
+        Argv args{workload == "overflow-view" ? "overflow" : workload, n_options, n_tokens};
+        std::string_view overflow = workload == "ids" ? "ids" : workload == "overflow-view" ? "file-view" : "file";
+        int reps = int(std::clamp<std::size_t>(1000000 / n_tokens, 3, 20));
+        auto m = measure(reps, [&] { return make_parser(n_options, overflow); },
+                         [&](Parser& p) { p.parse(args.argc(), args.argv()); });
+        reporter.report("parse", workload, n_options, n_tokens, m);
+      }
+    }
+    for (auto n_tokens : token_counts) {
+      Argv args{"overflow", n_options, n_tokens};
+      int reps = int(std::clamp<std::size_t>(1000000 / n_tokens, 3, 20));
+      auto m = measure(reps,
+                       [&] {
+                         auto state = std::make_unique<ArenaParser>();
+                         state->parser = make_parser(n_options, "file-view", &state->arena);
+                         return state;
+                       },
+                       [&](ArenaParser& state) { state.parser->parse(args.argc(), args.argv()); });
+      reporter.report("parse", "overflow-arena", n_options, n_tokens, m);
+    }
+    for (auto n_tokens : token_counts) {
+      Argv args{"flags", n_options, n_tokens};
+      int reps = int(std::clamp<std::size_t>(1000000 / n_tokens, 3, 20));
+      auto m = measure(reps,
+                       [&] {
+                         auto state = std::make_unique<FlatState>(n_options);
+                         make_flat_parser(*state, n_options);
+                         return state;
+                       },
+                       [&](FlatState& state) { state.parser->parse(args.argc(), args.argv()); });
+      reporter.report("parse", "flags-flat", n_options, n_tokens, m);
+    }
+
+    {
+      char name[] = "tabparse_bench_app";
+      char help[] = "--help";
+      char* help_argv[] = {name, help, nullptr};
+      SilenceStdout silence;
+      auto m = measure(5, [&] { return make_parser(n_options, "file"); },
+                       [&](Parser& p) { p.parse(2, help_argv); });
+      reporter.report("help", "all-kinds", n_options, 0, m);
+    }
+    {
+      auto m = measure(5, [&] { return make_parser(n_options, "file"); },
+                       [&](Parser& p) { p.print_completion("tabparse_bench_app"); });
+      reporter.report("completion", "all-kinds", n_options, 0, m);
+      std::remove("_tabparse_bench_app");
+    }
+    {
+      // registration and the answer itself, without process startup
+      char name[] = "tabparse_bench_app";
+      char flag_prefix[] = "--option-1";
+      char* words[] = {name, flag_prefix, nullptr};
+      auto m = measure(20, [] { return std::make_unique<int>(0); },
+                       [&](int&) {
+                         fmt::memory_buffer out;
+                         make_parser(n_options, "file")->render_candidates(out, ArgIter{words + 1}, ArgIter{words + 2}, 0);
+                       });
+      reporter.report("tab", "in-process", n_options, 0, m);
+      auto spawned = measure(10, [] { return std::make_unique<int>(0); },
+                             [&](int&) { spawn_completion(n_options, flag_prefix); });
+      reporter.report("tab", "spawn", n_options, 0, spawned);
+      if (spawned.ns > tab_budget_ns) {
+        fmt::print(stderr, "TAB latency with {} options exceeds the budget of {:.0f} ms\n", n_options, tab_budget_ns / 1e6);
+      }
+    }
+    {
+      // many short command lines against one shared parser, results reused
+      constexpr std::size_t n_lines = 20000;
+      constexpr std::size_t tokens_per_line = 32;
+      Argv args{"flags", n_options, tokens_per_line};
+      std::vector<CommandLine> lines(n_lines, CommandLine{args.argc(), args.argv()});
+      auto schema = make_parser(n_options, "file-view");
+      for (unsigned n_threads : {1u, std::max(2u, std::thread::hardware_concurrency())}) {
+        BatchParser batch{*schema, n_threads};
+        std::vector<ParseResult> results;
+        batch.parse(lines, results);
+        auto m = measure(5, [] { return std::make_unique<int>(0); },
+                         [&](int&) { batch.parse(lines, results); });
+        reporter.report("batch", fmt::format("{}-threads", n_threads), n_options, n_lines * tokens_per_line, m);
+      }
+    }
+    {
+      // command lines that are all wrong: a bad number, a bad choice and a
+      // switch with a value, reported by throwing or as diagnostics
+      constexpr std::size_t n_lines = 20000;
+      const char* bad[] = {"--option-0", "many", "--option-3", "delta", "--option-6=on"};
+      ArgIter first{bad};
+      ArgIter last{bad + std::size(bad)};
+      auto schema = make_parser(n_options, "file-view");
+      ParseResult result;
+      std::size_t n_failed = 0;
+      auto thrown = measure(5, [] { return std::make_unique<int>(0); },
+                            [&](int&) {
+                              for (std::size_t i = 0; i < n_lines; ++i) {
+                                try {
+                                  schema->parse(first, last, result);
+                                } catch (const std::invalid_argument&) {
+                                  ++n_failed;
+                                }
+                              }
+                            });
+      reporter.report("errors", "throw", n_options, n_lines, thrown);
+      auto listed = measure(5, [] { return std::make_unique<int>(0); },
+                            [&](int&) {
+                              for (std::size_t i = 0; i < n_lines; ++i) {
+                                n_failed += schema->try_parse(first, last, result) ? 0 : 1;
+                              }
+                            });
+      reporter.report("errors", "try_parse", n_options, n_lines, listed);
+      if (n_failed != 10 * n_lines) {
+        fmt::print(stderr, "error workload parsed {} of {} command lines\n", 10 * n_lines - n_failed, 10 * n_lines);
+      }
+    }
+  }
+  rmdir(tmpdir);
+  return 0;
+}
@@ -0,0 +1,114 @@
+// Compares resolving a token against the registered flag names by linear scan
+// (what Parser::parse and Parser::addArg used to do) with the hashed index the
+// Parser keeps now, for growing numbers of options, and reports the number of
+// options above which the hash wins.
+#include "parser.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <fmt/format.h>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+std::vector<std::string> make_names(std::size_t n) {
+  std::vector<std::string> names;
+  names.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    names.push_back(fmt::format("--option-number-{}", i));
+  }
+  return names;
+}
+
+// tokens are a mix of hits (uniform over all names) and misses (positionals)
+std::vector<std::string> make_tokens(const std::vector<std::string>& names, std::size_t n) {
+  std::mt19937 gen{42};
+  std::uniform_int_distribution<std::size_t> pick{0, names.size() - 1};
+  std::vector<std::string> tokens;
+  tokens.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (i % 4 == 3) {
+      tokens.push_back(fmt::format("positional/value/{}", i));
+    } else {
+      tokens.push_back(names[pick(gen)]);
+    }
+  }
+  return tokens;
+}
+
+// best of a few repetitions, to get rid of warm up and scheduling noise
+template <typename FUNC>
+double ns_per_call(std::size_t calls, FUNC&& func) {
+  double best = 0;
+  for (int rep = 0; rep < 5; ++rep) {
+    auto start = bench_clock::now();
+    func();
+    auto stop = bench_clock::now();
+    auto ns = std::chrono::duration<double, std::nano>(stop - start).count() / double(calls);
+    if (rep == 0 || ns < best) {
+      best = ns;
+    }
+  }
+  return best;
+}
+
+volatile std::size_t sink;
+}
+
+int main() {
+  constexpr std::size_t n_tokens = 1 << 16;
+  std::size_t crossover = 0;
+  fmt::print("{:>8} {:>14} {:>14} {:>18}\n", "options", "linear ns/tok", "hashed ns/tok", "register ns/opt");
+  for (std::size_t n_options = 1; n_options <= 4096; n_options *= 2) {
+    auto names = make_names(n_options);
+    auto tokens = make_tokens(names, n_tokens);
+
+    std::vector<std::unique_ptr<std::string>> linear;
+    for (const auto& name : names) {
+      linear.push_back(std::make_unique<std::string>(name));
+    }
+    std::unordered_map<std::string_view, const std::string*> hashed;
+    for (const auto& name : linear) {
+      hashed.emplace(*name, name.get());
+    }
+
+    auto linear_ns = ns_per_call(n_tokens, [&] {
+      std::size_t found = 0;
+      for (const auto& token : tokens) {
+        std::string_view tok = token;
+        auto res = std::find_if(linear.begin(), linear.end(), [tok](const auto& name) { return tok == *name; });
+        found += res != linear.end();
+      }
+      sink = found;
+    });
+    auto hashed_ns = ns_per_call(n_tokens, [&] {
+      std::size_t found = 0;
+      for (const auto& token : tokens) {
+        found += hashed.find(token) != hashed.end();
+      }
+      sink = found;
+    });
+    auto register_ns = ns_per_call(n_options, [&] {
+      Parser p;
+      for (const auto& name : names) {
+        sink = p.addArg<SwitchArg>(name, false, "", "switch")->ref();
+      }
+    });
+
+    // the crossover is where the hash starts winning for good
+    if (hashed_ns >= linear_ns) {
+      crossover = 0;
+    } else if (crossover == 0) {
+      crossover = n_options;
+    }
+    fmt::print("{:>8} {:>14.1f} {:>14.1f} {:>18.1f}\n", n_options, linear_ns, hashed_ns, register_ns);
+  }
+  fmt::print("hashed lookup is faster from {} options on\n", crossover);
+  return 0;
+}
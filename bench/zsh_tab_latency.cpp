@@ -0,0 +1,261 @@
+// Measures what a user waits for at the TAB key: drives an interactive zsh
+// in a pseudo terminal, types a command line of a program with one large
+// StringChoiceArg and times from sending TAB until the completed value is
+// echoed. Compares the completion file with all choices inline in the
+// _arguments spec (Parser::completion_helper_threshold above the number of
+// choices) with the one that moves them into a helper function.
+//
+// The first TAB of a shell loads the completion function, later ones are
+// reported separately. Every shell after the first one of a variant finds the
+// _store_cache file of the ones before. One JSON object per measurement goes
+// to stdout, a summary to stderr. Needs zsh, run with --zsh PATH if it is not
+// on the PATH.
+#include "parser.h"
+#include "v_opt.h"
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <cstdlib>
+#include <csignal>
+#include <fmt/format.h>
+#include <limits>
+#include <optional>
+#include <poll.h>
+#include <pty.h>
+#include <spawn.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+extern char** environ;
+
+namespace {
+using bench_clock = std::chrono::steady_clock;
+
+constexpr std::string_view app_name = "tabparse_zsh_app";
+constexpr auto answer_timeout = std::chrono::seconds(10);
+
+std::string choice(std::size_t i) {
+  return fmt::format("choice-{}-done{}", i, i);
+}
+
+// the completion file for a program with n_choices values of --choice
+std::string completion_file(std::size_t n_choices, std::size_t helper_threshold) {
+  std::vector<std::string> choices;
+  std::vector<std::string> descriptions;
+  choices.reserve(n_choices);
+  descriptions.reserve(n_choices);
+  for (std::size_t i = 0; i < n_choices; ++i) {
+    choices.push_back(choice(i));
+    descriptions.push_back(fmt::format("description of choice {}", i));
+  }
+  Parser p;
+  (void)p.addArg<StringChoiceArg>("--choice", choices.front(), "CHOICE", "one of many", choices, descriptions);
+  (void)p.addArg<IntArg>("-j", 1, "N", "some other option");
+  p.completion_helper_threshold(helper_threshold);
+  fmt::memory_buffer out;
+  p.render_completion(out, app_name);
+  return {out.data(), out.size()};
+}
+
+bool zsh_runs(const std::string& zsh) {
+  char* child_argv[] = {const_cast<char*>(zsh.c_str()), const_cast<char*>("-fc"), const_cast<char*>("true"), nullptr};
+  pid_t pid;
+  if (posix_spawnp(&pid, zsh.c_str(), nullptr, nullptr, child_argv, environ) != 0) {
+    return false;
+  }
+  int status = 0;
+  return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// an interactive zsh -f on the slave side of a pty
+class Shell {
+  public:
+    Shell(const std::string& zsh, const std::string& dir) {
+      m_pid = forkpty(&m_fd, nullptr, nullptr, nullptr);
+      if (m_pid < 0) {
+        throw std::runtime_error("forkpty failed");
+      }
+      if (m_pid == 0) {
+        execlp(zsh.c_str(), zsh.c_str(), "-f", "-i", static_cast<char*>(nullptr));
+        _exit(127);
+      }
+      // the arithmetic keeps the marker out of the echo of the command
+      send(fmt::format("bindkey -e; PROMPT='> '; fpath=({0} $fpath); "
+                       "zstyle ':completion:*' use-cache on; zstyle ':completion:*' cache-path {0}/cache; "
+                       "autoload -Uz compinit; compinit -u -d {0}/zcompdump; print TABPARSE_$((40+2))\n",
+                       dir));
+      if (!wait_for("TABPARSE_42")) {
+        throw std::runtime_error("zsh did not come up");
+      }
+    }
+    Shell(const Shell&) = delete;
+    Shell& operator=(const Shell&) = delete;
+    ~Shell() {
+      send("\x15" "exit\n");
+      ::close(m_fd);
+      int status = 0;
+      if (waitpid(m_pid, &status, WNOHANG) == 0) {
+        ::kill(m_pid, SIGKILL);
+        waitpid(m_pid, &status, 0);
+      }
+    }
+    void send(std::string_view text) {
+      while (!text.empty()) {
+        auto written = ::write(m_fd, text.data(), text.size());
+        if (written < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          throw std::runtime_error("could not write to the pty");
+        }
+        text.remove_prefix(std::size_t(written));
+      }
+    }
+    // reads until marker shows up in the output since the last call
+    bool wait_for(std::string_view marker) {
+      m_seen.clear();
+      auto deadline = bench_clock::now() + answer_timeout;
+      char chunk[4096];
+      while (m_seen.find(marker) == std::string::npos) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - bench_clock::now()).count();
+        pollfd pfd{m_fd, POLLIN, 0};
+        if (left <= 0 || ::poll(&pfd, 1, int(left)) <= 0) {
+          return false;
+        }
+        auto n = ::read(m_fd, chunk, sizeof(chunk));
+        if (n <= 0) {
+          return false;
+        }
+        m_seen.append(chunk, std::size_t(n));
+      }
+      return true;
+    }
+  private:
+    pid_t m_pid{-1};
+    int m_fd{-1};
+    std::string m_seen;
+};
+
+struct Timings {
+  std::vector<double> first_ns;
+  std::vector<double> warm_ns;
+};
+
+// types the line up to the unique prefix of a choice, then times the TAB
+std::optional<double> time_tab(Shell& shell, std::size_t i) {
+  auto value = choice(i);
+  auto prefix = value.substr(0, value.find("done") + 1);
+  shell.send(fmt::format("{} --choice {}", app_name, prefix));
+  if (!shell.wait_for(prefix)) {
+    return std::nullopt;
+  }
+  auto start = bench_clock::now();
+  shell.send("\t");
+  if (!shell.wait_for(value.substr(prefix.size()))) {
+    return std::nullopt;
+  }
+  auto stop = bench_clock::now();
+  // kill the line for the next round
+  shell.send("\x15");
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+}
+
+std::optional<Timings> run_variant(const std::string& zsh, const std::string& dir, std::size_t n_choices,
+                                   std::size_t n_shells, std::size_t n_tabs) {
+  Timings timings;
+  std::size_t next = 0;
+  for (std::size_t s = 0; s < n_shells; ++s) {
+    std::optional<Shell> shell;
+    try {
+      shell.emplace(zsh, dir);
+    } catch (const std::runtime_error& e) {
+      fmt::print(stderr, "{}\n", e.what());
+      return std::nullopt;
+    }
+    for (std::size_t t = 0; t < n_tabs; ++t) {
+      // spread over the list, never the same value twice in a shell
+      auto tab = time_tab(*shell, (next++ * 7919) % n_choices);
+      if (!tab) {
+        return std::nullopt;
+      }
+      (t == 0 ? timings.first_ns : timings.warm_ns).push_back(*tab);
+    }
+  }
+  return timings;
+}
+
+double median(std::vector<double> values) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::nth_element(values.begin(), values.begin() + std::ptrdiff_t(values.size() / 2), values.end());
+  return values[values.size() / 2];
+}
+}
+
+int main(int argc, char** argv) {
+  Parser cli;
+  auto& zsh = cli.addArg<StringArg>("--zsh", "zsh", "PATH", "the zsh to drive")->ref();
+  auto& n_shells = cli.addArg<IntArg>("--shells", 5, "N", "shells per variant, each one starts cold")->ref();
+  auto& n_tabs = cli.addArg<IntArg>("--tabs", 20, "N", "TABs per shell")->ref();
+  auto& quick = cli.addArg<SwitchArg>("--quick", false, "", "only run the small configurations")->ref();
+  cli.parse(argc, argv);
+  if (n_shells < 1 || n_tabs < 1) {
+    fmt::print(stderr, "--shells and --tabs must be positive.\n");
+    return EXIT_FAILURE;
+  }
+  if (!zsh_runs(zsh)) {
+    fmt::print(stderr, "could not run {}, nothing measured.\n", zsh);
+    return EXIT_SUCCESS;
+  }
+  char dir_template[] = "/tmp/tabparse_zsh_XXXXXX";
+  if (mkdtemp(dir_template) == nullptr) {
+    fmt::print(stderr, "could not create a temporary directory.\n");
+    return EXIT_FAILURE;
+  }
+  std::string root{dir_template};
+
+  std::vector<std::size_t> sizes{100, 1000};
+  if (!quick) {
+    sizes.push_back(10000);
+    sizes.push_back(50000);
+  }
+  struct Variant {
+    std::string_view name;
+    std::size_t threshold;
+  };
+  const Variant variants[] = {{"inline", std::numeric_limits<std::size_t>::max()},
+                              {"helper", Parser::default_helper_threshold}};
+  int retval = EXIT_SUCCESS;
+  fmt::print(stderr, "{:>8} {:>8} {:>14} {:>14}\n", "choices", "variant", "first TAB [ms]", "warm TAB [ms]");
+  for (auto n_choices : sizes) {
+    for (const auto& variant : variants) {
+      auto dir = fmt::format("{}/{}-{}", root, variant.name, n_choices);
+      if (::mkdir(dir.c_str(), 0755) != 0) {
+        fmt::print(stderr, "could not create {}.\n", dir);
+        return EXIT_FAILURE;
+      }
+      auto file = completion_file(n_choices, variant.threshold);
+      write_buffer(fmt::format("{}/_{}", dir, app_name), file);
+      auto timings = run_variant(zsh, dir, n_choices, std::size_t(n_shells), std::size_t(n_tabs));
+      if (!timings) {
+        fmt::print(stderr, "{:>8} {:>8} no answer within {} s\n", n_choices, variant.name, answer_timeout.count());
+        retval = EXIT_FAILURE;
+        continue;
+      }
+      auto first = median(timings->first_ns);
+      auto warm = median(timings->warm_ns);
+      fmt::print("{{\"bench\": \"zsh_tab\", \"variant\": \"{}\", \"choices\": {}, \"file_bytes\": {}, "
+                 "\"first_ns\": {:.0f}, \"warm_ns\": {:.0f}}}\n",
+                 variant.name, n_choices, file.size(), first, warm);
+      fmt::print(stderr, "{:>8} {:>8} {:>14.2f} {:>14.2f}\n", n_choices, variant.name, first * 1e-6, warm * 1e-6);
+    }
+  }
+  fmt::print(stderr, "shells, completion files and caches are left in {}\n", root);
+  return retval;
+}
@@ -0,0 +1,40 @@
+# tabparse_add_completion(<target> [NAME <command>] [DESTINATION <dir>] [NO_INSTALL])
+#
+# Generates the zsh completion function _<command> of the tabparse program
+# <target> whenever the program is relinked, and installs it to <dir>
+# (${CMAKE_INSTALL_DATADIR}/zsh/site-functions by default) unless NO_INSTALL
+# is given. <command> is the name the function completes, the OUTPUT_NAME of
+# the target by default.
+#
+# The program is run as `<target> __tabparse_generate <command> <file>`, so
+# it only registers its arguments (see Parser::generation_request). It leaves
+# the file untouched if the schema fingerprint in it is still the same, such
+# that nothing depending on the file runs again.
+function(tabparse_add_completion target)
+  cmake_parse_arguments(PARSE_ARGV 1 arg "NO_INSTALL" "NAME;DESTINATION" "")
+  if (NOT arg_NAME)
+    get_target_property(arg_NAME ${target} OUTPUT_NAME)
+    if (NOT arg_NAME)
+      set(arg_NAME ${target})
+    endif()
+  endif()
+  if (NOT arg_DESTINATION)
+    include(GNUInstallDirs)
+    set(arg_DESTINATION ${CMAKE_INSTALL_DATADIR}/zsh/site-functions)
+  endif()
+  set(script ${CMAKE_CURRENT_BINARY_DIR}/_${arg_NAME})
+  # the stamp tells the build tool that the program ran, the script itself
+  # keeps its timestamp when it did not change
+  set(stamp ${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${target}_completion.stamp)
+  add_custom_command(OUTPUT ${stamp}
+    BYPRODUCTS ${script}
+    COMMAND ${target} __tabparse_generate ${arg_NAME} ${script}
+    COMMAND ${CMAKE_COMMAND} -E touch ${stamp}
+    DEPENDS ${target}
+    COMMENT "Generating zsh completion _${arg_NAME}"
+    VERBATIM)
+  add_custom_target(${target}_completion ALL DEPENDS ${stamp})
+  if (NOT arg_NO_INSTALL)
+    install(FILES ${script} DESTINATION ${arg_DESTINATION})
+  endif()
+endfunction()
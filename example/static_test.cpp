@@ -0,0 +1,35 @@
+#include "static_schema.h"
+#include <fmt/format.h>
+
+constexpr std::string_view modes[] = {"demonstrate", "party", "lazy"};
+constexpr std::string_view mode_docs[] = {"demonstrate usage", "do something crazy", "do nothing"};
+
+inline constexpr auto schema = make_schema(
+    StaticArg::Directory("--build-dir", ".", "BUILDDIR", "specify the build directory").required(true),
+    StaticArg::File("--some-file", "main.cpp", "FILE", "specify some file", "*.cpp"),
+    StaticArg::Int("-j", 42, "CONCURRENCY", "specify the concurrency level"),
+    StaticArg::StringChoice("--mode", "demonstrate", "MODE", "specify running mode", modes, mode_docs),
+    StaticArg::String("--tag", "", "TAG", "add a tag").vector(),
+    StaticArg::Int("bignum", 1337, "BIGNUM", "specify yet another number").positional().required(true),
+    StaticArg::Directory("others", "", "OTHERDIR", "specify a ship to fly through the delta quadrant").others());
+
+// the zsh completion is a string literal in the binary
+static_assert(StaticTables<schema>::completion_body.substr(0, 10) == "_arguments");
+
+int main(int argc, char** argv) {
+  StaticParser<schema> p;
+  p.parse(argc, argv);
+
+  fmt::print("build dir   has value {}\n", p.get<p.index("--build-dir")>());
+  fmt::print("some file   has value {}\n", p.get<p.index("--some-file")>());
+  fmt::print("concurrency has value {}\n", p.get<p.index("-j")>());
+  fmt::print("mode        has value {}\n", p.get<p.index("--mode")>());
+  for (auto tag : p.get<p.index("--tag")>()) {
+    fmt::print("    tag {}\n", tag);
+  }
+  fmt::print("pos. int    has value {}\n", p.get<p.index("bignum")>());
+  for (auto other : p.get<p.index("others")>()) {
+    fmt::print("    overflow has val {}\n", other);
+  }
+  return 0;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "parser.h"
+#include "parse_result.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// One command line as main receives it, argv[0] being the program name.
+struct CommandLine {
+  int argc;
+  const char* const* argv;
+};
+
+// Parses many command lines against one (fully registered) Parser on a pool of
+// worker threads.
+class BatchParser {
+  public:
+    explicit BatchParser(const Parser& parser, unsigned n_threads = std::thread::hardware_concurrency());
+    ~BatchParser();
+    BatchParser(const BatchParser&) = delete;
+    BatchParser& operator=(const BatchParser&) = delete;
+    // results[i] becomes the outcome of commands[i]. Passing the same results
+    // again reuses their storage. Command lines that do not parse do not
+    // throw, they leave the message in ParseResult::error instead, as do
+    // exceptions thrown while parsing one of them. Only a failure to store
+    // such a message is rethrown here, after all workers are done.
+    void parse(const std::vector<CommandLine>& commands, std::vector<ParseResult>& results);
+  private:
+    void work();
+    void parse_range();
+    const Parser& m_parser;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::vector<CommandLine>* m_commands{nullptr};
+    std::vector<ParseResult>* m_results{nullptr};
+    std::atomic<std::size_t> m_next{0};
+    std::size_t m_generation{0};
+    std::size_t m_busy{0};
+    // the first exception a worker could not store in a result
+    std::exception_ptr m_failure;
+    bool m_stop{false};
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "batch.cpp"
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+// The values of a DynamicChoiceArg, which are computed at runtime and may be
+// expensive to enumerate (scanning an index, asking a database). They are
+// computed at most once per process and kept on disk for later processes,
+// such that completing the value at every TAB reads a file instead.
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+struct ChoiceList {
+  std::vector<std::string> values;
+  // empty, or one per value
+  std::vector<std::string> descriptions;
+};
+
+using ChoiceProvider = std::function<ChoiceList()>;
+
+// $XDG_CACHE_HOME/tabparse/key, or ~/.cache/tabparse/key if it is not set
+[[nodiscard]] std::string choice_cache_path(std::string_view key);
+// the list stored at path, if there is one younger than ttl
+[[nodiscard]] std::optional<ChoiceList> read_choice_cache(const std::string& path, std::chrono::seconds ttl);
+// creates the directories as needed and replaces the file atomically. Errors
+// are ignored, completion and parsing work without a writable cache.
+void write_choice_cache(const std::string& path, const ChoiceList& list);
+
+class ChoiceCache {
+  public:
+    ChoiceCache(std::string_view key, ChoiceProvider provider, std::chrono::seconds ttl)
+        : m_path{choice_cache_path(key)}, m_provider{std::move(provider)}, m_ttl{ttl} {}
+    // from the cache file if it is fresh, from the provider (and then stored)
+    // otherwise. Safe to call from several threads.
+    [[nodiscard]] const ChoiceList& get() const;
+    [[nodiscard]] bool contains(std::string_view value) const;
+    // removes the cache file, the next get() asks the provider. Must not run
+    // concurrently with get().
+    void invalidate();
+    [[nodiscard]] const std::string& path() const { return m_path; }
+  private:
+    void load() const;
+    std::string m_path;
+    ChoiceProvider m_provider;
+    std::chrono::seconds m_ttl;
+    mutable std::mutex m_mutex;
+    mutable std::atomic<bool> m_loaded{false};
+    mutable ChoiceList m_list;
+    // views of m_list.values
+    mutable std::unordered_set<std::string_view> m_index;
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "choice_cache.cpp"
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+// The configuration file arguments fall back to when they are not on the
+// command line, see Parser::config_file. Lines are
+//
+//   key = value
+//
+// with whitespace around key and value ignored and double quotes around the
+// value removed. Empty lines and lines starting with # are skipped. A key may
+// be repeated, for arguments that take several values.
+//
+// The file is mapped read only. It is only scanned on the first lookup, and
+// then only split into views of keys and values, converting a value is left
+// to the argument that asks for it.
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+class ConfigFile {
+  public:
+    // a file that does not exist is empty. So is one that can not be read,
+    // error() tells why.
+    explicit ConfigFile(std::string path);
+    ConfigFile(ConfigFile&& other) noexcept;
+    ConfigFile& operator=(ConfigFile&& other) noexcept;
+    ConfigFile(const ConfigFile&) = delete;
+    ConfigFile& operator=(const ConfigFile&) = delete;
+    ~ConfigFile();
+    [[nodiscard]] const std::string& path() const { return m_path; }
+    // the values of key in file order, nullptr if the file does not set it.
+    // The views stay valid for the lifetime of the ConfigFile.
+    [[nodiscard]] const std::vector<std::string_view>* values(std::string_view key);
+    // the first line that is not of the form key = value (and is skipped),
+    // empty if there is none. Only known after the first lookup.
+    [[nodiscard]] std::string_view malformed_line() const { return m_malformed; }
+    // why the file could not be read, empty if it could (or does not exist)
+    [[nodiscard]] const std::string& error() const { return m_error; }
+  private:
+    void scan();
+    std::string m_path;
+    const char* m_data{nullptr};
+    std::size_t m_size{0};
+    bool m_scanned{false};
+    std::string m_error;
+    std::string_view m_malformed;
+    std::unordered_map<std::string_view, std::vector<std::string_view>> m_index;
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "config_file.cpp"
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+// Rules about which arguments of a Parser may, or have to, be given together:
+// the required arguments, groups of which at most, exactly or at least one
+// may be given, and arguments that need others. They are compiled into bit
+// masks over the slots of a ParseResult when they are registered, so checking
+// a parse is a few word operations per rule against its presence bitmap
+// instead of a visit to every argument.
+#include "v_opt.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <initializer_list>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+BETTER_ENUM(GroupKind, int, AtMostOne, ExactlyOne, AtLeastOne)
+
+class Constraints {
+  public:
+    using Mask = std::vector<std::uint64_t>;
+    // registers arg under its slot, positional arguments in command line order
+    void add(const ArgBase& arg, bool positional);
+    // see TemplateArg::required
+    void require(const ArgBase& arg, bool required);
+    void add_group(GroupKind kind, std::initializer_list<const ArgBase*> members);
+    // arg may only be given together with all of needed
+    void add_dependency(const ArgBase& arg, std::initializer_list<const ArgBase*> needed);
+    // appends a diagnostic for each required argument missing from present
+    // (but skip) and for each broken rule
+    void check(const std::pmr::vector<std::uint64_t>& present, const ArgBase* skip, std::pmr::vector<Diagnostic>& out) const;
+    // sets the bits of the arguments a group rules out next to present
+    void excluded(const Mask& present, Mask& out) const;
+    // the arguments arg rules out, for its zsh exclusion list
+    [[nodiscard]] std::vector<const ArgBase*> conflicts(const ArgBase& arg) const;
+    [[nodiscard]] bool has_groups() const { return m_n_groups != 0; }
+  private:
+    enum class RuleKind : std::uint8_t { AtMostOne, AtLeastOne, Needs };
+    struct Rule {
+      RuleKind kind;
+      // the argument that needs members, for Needs
+      const ArgBase* trigger;
+      Mask members;
+      std::vector<const ArgBase*> args;
+      // "--a, --b", diagnostics of AtLeastOne point into it
+      std::string names;
+    };
+    [[nodiscard]] const ArgBase& own(const ArgBase* arg) const;
+    template <typename WORDS>
+    [[nodiscard]] static bool test(const WORDS& mask, std::size_t slot) {
+      return slot / 64 < mask.size() && (mask[slot / 64] >> (slot % 64)) & 1u;
+    }
+    static void set(Mask& mask, std::size_t slot);
+    void add_rule(RuleKind kind, const ArgBase* trigger, std::initializer_list<const ArgBase*> members);
+    // by slot
+    std::vector<const ArgBase*> m_args;
+    std::vector<std::size_t> m_positionals;
+    // what required() asked for, and that plus the positional arguments
+    // before a required one, see Parser::sanitize
+    Mask m_explicit;
+    Mask m_required;
+    // the views of diagnostics stay valid while rules are added
+    std::deque<Rule> m_rules;
+    std::size_t m_n_groups{0};
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "constraints.cpp"
+#endif
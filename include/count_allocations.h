@@ -0,0 +1,40 @@
+#pragma once
+// Include in exactly one translation unit of a program to have the parse
+// statistics (see parse_stats.h) count allocations. Replaces the global
+// operator new and delete with ones that count, per thread, and forward to
+// malloc/free.
+#include "parse_stats.h"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+// none of these are inlined: GCC would see a pointer from malloc reach
+// operator delete, or one from operator new reach free, and warn about a
+// mismatch (-Wmismatched-new-delete) at every new and delete
+[[gnu::noinline]] void* operator new(std::size_t size) {
+  ++parse_stats_detail::allocations;
+  parse_stats_detail::allocated_bytes += size;
+  if (void* ptr = std::malloc(size == 0 ? 1 : size)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+[[gnu::noinline]] void* operator new[](std::size_t size) {
+  return ::operator new(size);
+}
+[[gnu::noinline]] void operator delete(void* ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete[](void* ptr) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete[](void* ptr, std::size_t) noexcept { std::free(ptr); }
+// std::pmr::new_delete_resource allocates through these
+[[gnu::noinline]] void* operator new(std::size_t size, std::align_val_t align) {
+  ++parse_stats_detail::allocations;
+  parse_stats_detail::allocated_bytes += size;
+  auto alignment = std::max(std::size_t(align), sizeof(void*));
+  if (void* ptr = std::aligned_alloc(alignment, (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc{};
+}
+[[gnu::noinline]] void operator delete(void* ptr, std::align_val_t) noexcept { std::free(ptr); }
+[[gnu::noinline]] void operator delete(void* ptr, std::size_t, std::align_val_t) noexcept { std::free(ptr); }
@@ -0,0 +1,46 @@
+#pragma once
+// Prefix tree over the flag names of a Parser, for what the hashed index
+// can not answer: which flag an abbreviation stands for and which flag a
+// mistyped token was meant to be.
+//
+// Nodes are stored in one array, each with its first child and next sibling,
+// and every node knows the only name below it (if there is just one). Both
+// exact and prefix lookups thus walk one node per character of the token.
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+class FlagTrie {
+  public:
+    static constexpr std::uint32_t npos = ~std::uint32_t{0};
+    void insert(std::string_view name, std::uint32_t value);
+    // value of name, npos if it was not inserted
+    [[nodiscard]] std::uint32_t find(std::string_view name) const;
+    // value of the only name starting with prefix, npos if there is none or
+    // the prefix is ambiguous
+    [[nodiscard]] std::uint32_t complete(std::string_view prefix) const;
+    // value of a name at most max_distance insertions, deletions or
+    // substitutions away from token (the closest, the first inserted among
+    // equally close ones), npos if there is none. Subtrees whose every name
+    // is further away than the best candidate so far are not visited.
+    [[nodiscard]] std::uint32_t closest(std::string_view token, std::size_t max_distance) const;
+  private:
+    struct Node {
+      std::uint32_t child{npos};
+      std::uint32_t sibling{npos};
+      // value of the name ending here
+      std::uint32_t value{npos};
+      // value of the only name in this subtree, npos if there are several
+      std::uint32_t unique{npos};
+      char label{0};
+    };
+    [[nodiscard]] std::uint32_t walk(std::string_view text) const;
+    // node 0 is the root, for the empty prefix
+    std::vector<Node> m_nodes{Node{}};
+    std::size_t m_longest{0};
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "flag_trie.cpp"
+#endif
@@ -0,0 +1,73 @@
+#pragma once
+// Runtime registry of flat argument descriptors, for programs that register
+// hundreds of options and care about their startup.
+//
+// Where Parser creates one polymorphic object with three std::strings per
+// argument, FlatParser keeps the StaticArg descriptors of static_schema.h in
+// one contiguous array and their values in separate dense arrays. The strings
+// of a descriptor are not copied, they must outlive the FlatParser (string
+// literals do). All storage comes from the given memory resource, with a
+// std::pmr::monotonic_buffer_resource over a large enough buffer registration
+// does not touch the heap at all:
+//
+//   std::array<std::byte, 64 * 1024> buffer;
+//   std::pmr::monotonic_buffer_resource arena{buffer.data(), buffer.size()};
+//   FlatParser p{&arena};
+//   auto j = p.add(StaticArg::Int("-j", 42, "CONCURRENCY", "specify the concurrency level"));
+//   p.parse(argc, argv);
+//   long concurrency = p.int_value(j);
+#include "static_schema.h"
+#include "v_opt.h"
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <memory_resource>
+#include <string_view>
+#include <vector>
+
+class FlatParser {
+  public:
+    explicit FlatParser(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+    // avoids regrowing the arrays when the number of arguments is known
+    void reserve(std::size_t n_args);
+    // returns the index to query the values with
+    std::size_t add(const StaticArg& arg);
+    [[nodiscard]] std::size_t index(std::string_view name) const;
+    // values are views into argv, each call forgets those of the last one
+    void parse(int argc, char* argv[]);
+
+    [[nodiscard]] bool present(std::size_t idx) const {
+      return m_present[idx / 64] & (std::uint64_t{1} << (idx % 64));
+    }
+    // the last value given, or the default
+    [[nodiscard]] long int_value(std::size_t idx) const;
+    [[nodiscard]] std::string_view string_value(std::size_t idx) const;
+    // all values of a repeated argument (StaticArg::vector or others)
+    [[nodiscard]] const TokenList& values(std::size_t idx) const { return m_repeated[idx]; }
+
+    // to stdout
+    void print_help(std::string_view appname) const;
+    void render_help(fmt::memory_buffer& out, std::string_view appname, std::size_t width) const;
+    // to the file _appname in the working directory
+    void print_completion(std::string_view appname) const;
+    void render_completion(fmt::memory_buffer& out, std::string_view appname) const;
+  private:
+    [[nodiscard]] std::size_t find_flag(std::string_view token) const;
+    void insert(std::size_t idx);
+    void store(std::size_t idx, std::string_view value);
+    std::pmr::vector<StaticArg> m_args;
+    // open addressing table of index+1 into m_args, 0 marks an empty slot
+    std::pmr::vector<std::uint32_t> m_lookup;
+    // indices of the positional arguments, in order
+    std::pmr::vector<std::uint32_t> m_positionals;
+    // index of the overflow argument, m_args.size() if there is none
+    std::size_t m_others{0};
+    std::pmr::vector<std::uint64_t> m_required;
+    std::pmr::vector<std::uint64_t> m_present;
+    std::pmr::vector<std::string_view> m_values;
+    std::pmr::vector<TokenList> m_repeated;
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "flat_parser.cpp"
+#endif
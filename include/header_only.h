@@ -0,0 +1,9 @@
+#pragma once
+// With TABPARSE_HEADER_ONLY defined, every header includes its source file at
+// its end and tabparse needs no library to link. The functions of the sources
+// are then defined in every translation unit that uses them and must be inline.
+#ifdef TABPARSE_HEADER_ONLY
+#define TABPARSE_INLINE inline
+#else
+#define TABPARSE_INLINE
+#endif
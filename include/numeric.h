@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+// Conversion of tokens to numbers, for NumericArg and the static schema.
+//
+// Integers are read like strtol with base 0 reads them: decimal, hexadecimal
+// after 0x and octal after a leading 0, with an optional sign. Unlike strtol,
+// values that do not fit NUMBER are rejected instead of truncated, and so are
+// negative values for unsigned types. Decimal digits are consumed eight at a
+// time on little endian platforms.
+
+// the whole token as one number, throws std::invalid_argument otherwise
+template <typename NUMBER>
+[[nodiscard]] NUMBER parse_number(std::string_view token);
+
+// A list of numbers: comma separated items, each a number or, for integers,
+// an inclusive range FIRST-LAST. E.g. 1,5,9 or 1-1000 or 1-3,7. Appends the
+// numbers to out (if not null) and returns how many there are, such that a
+// list can be validated without expanding it. A list may stand for at most
+// max_list_values numbers, a token must not make the program allocate
+// gigabytes.
+inline constexpr std::size_t max_list_values = std::size_t{1} << 20;
+template <typename NUMBER>
+std::size_t parse_number_list(std::string_view token, std::pmr::vector<NUMBER>* out);
+
+// validation without exceptions: std::errc{} if parse_number would accept
+// token, std::errc::result_out_of_range for values too large,
+// std::errc::invalid_argument otherwise
+template <typename NUMBER>
+[[nodiscard]] std::errc check_number(std::string_view token);
+
+// what is wrong with a list token: one of its numbers (as told by the errc of
+// check_number), a range of floating point numbers, a range whose end is
+// below its start, or more than max_list_values numbers
+enum class ListError : std::uint8_t { None, Number, FloatRange, Descending, TooLarge };
+// validation of a list without exceptions, ec is set for ListError::Number
+template <typename NUMBER>
+[[nodiscard]] ListError check_number_list(std::string_view token, std::errc& ec);
+// the first range FIRST-LAST of an integer list token with LAST below FIRST,
+// for messages about ListError::Descending. Empty if there is none.
+[[nodiscard]] std::string_view descending_range(std::string_view token);
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "numeric.cpp"
+#endif
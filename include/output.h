@@ -0,0 +1,71 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Help and completion output is rendered into one buffer and then handed to
+// the kernel in a single write.
+void write_buffer(int fd, std::string_view data);
+// creates or truncates path
+void write_buffer(std::string_view path, std::string_view data);
+// whether the file path exists and its content starts with prefix
+[[nodiscard]] bool file_starts_with(std::string_view path, std::string_view prefix);
+
+// columns of the terminal on fd, or $COLUMNS, 0 if neither is known
+[[nodiscard]] std::size_t terminal_width(int fd);
+
+// appends text, breaking lines between words such that they end before width;
+// continuation lines are indented to column. width 0 disables wrapping.
+void append_wrapped(fmt::memory_buffer& out, std::string_view text, std::size_t column, std::size_t width);
+
+// appends one line value:description for zsh's _describe, colons in value are
+// escaped. Lines in the description are joined.
+void append_candidate(fmt::memory_buffer& out, std::string_view value, std::string_view description);
+
+// 64 bit FNV-1a, continuing from seed to hash several pieces
+constexpr std::uint64_t fingerprint(std::string_view text, std::uint64_t seed = 14695981039346656037ULL) {
+  for (char c : text) {
+    seed = (seed ^ std::uint8_t(c)) * 1099511628211ULL;
+  }
+  return seed;
+}
+
+// appends text as one single quoted zsh word
+void append_quoted(fmt::memory_buffer& out, std::string_view text);
+
+// appends the action of an _arguments spec that offers values (with
+// descriptions, unless there are none). Up to helper_threshold values are
+// spelled out, longer lists refer to the function of append_choice_function.
+void append_choice_action(fmt::memory_buffer& out, std::string_view title, const std::vector<std::string>& values,
+                          const std::vector<std::string>& descriptions, std::size_t helper_threshold);
+// appends the definition of a zsh function that offers the values through
+// _describe. The array of values is built once per shell and kept with
+// _store_cache if the use-cache style is set, such that a TAB does not re-read
+// the whole list. The function is named after a hash of the list, completion
+// files of different programs can define it alike.
+void append_choice_function(fmt::memory_buffer& out, std::string_view title, const std::vector<std::string>& values,
+                            const std::vector<std::string>& descriptions);
+[[nodiscard]] std::string choice_function_name(std::string_view title, const std::vector<std::string>& values,
+                                               const std::vector<std::string>& descriptions);
+
+// the first argument with which a completion function asks the program for
+// the candidates of a word, see Parser::completion_request
+inline constexpr std::string_view dynamic_complete_keyword = "__tabparse_complete";
+// the copy of words a completion function with subcommands keeps before
+// _arguments shifts words to the subcommand, see append_dynamic_query
+inline constexpr std::string_view query_words_name = "_tabparse_words";
+// appends the shell code that asks the program for the candidates of
+// words[CURRENT] and offers them, each line starting with indent. Below a
+// subcommand it passes the whole command line kept in query_words_name.
+void append_dynamic_query(fmt::memory_buffer& out, std::string_view indent);
+// appends the function query_function_name running that code, the action of
+// _arguments specs whose values only the program itself knows
+inline constexpr std::string_view query_function_name = "_tabparse_query";
+void append_query_function(fmt::memory_buffer& out);
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "output.cpp"
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+#include "v_opt.h"
+#include "response_file.h"
+#include "config_file.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// The outcome of parsing one command line with Parser::parse(ArgIter, ArgIter,
+// ParseResult&). That overload leaves the Parser untouched, so a single Parser
+// can serve many threads at once, each parsing into its own ParseResult.
+//
+// Values are kept as views of the parsed tokens and are only converted when
+// asked for with get(). A ParseResult can be reused for many parses, it then
+// keeps its storage. Response files of the command line stay mapped as long
+// as the ParseResult is not reused, values from them point into the mapping.
+//
+// All storage comes from the given memory resource. With a
+// std::pmr::monotonic_buffer_resource the results of many parses can be
+// released in one go by releasing the resource.
+class ParseResult {
+  public:
+    explicit ParseResult(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_values{resource}, m_present{resource}, m_touched{resource}, m_paths{resource}, m_diagnostics{resource} {}
+    [[nodiscard]] bool present(const ArgBase* arg) const {
+      return arg->m_slot / 64 < m_present.size() && (m_present[arg->m_slot / 64] >> (arg->m_slot % 64)) & 1u;
+    }
+    // all tokens given for arg, in command line order
+    [[nodiscard]] const TokenList& tokens(const ArgBase* arg) const {
+      return m_values[arg->m_slot];
+    }
+    // what arg->ref() would return after the Parser::parse that stores values
+    // in the arguments themselves
+    template <typename ARGTYPE>
+    [[nodiscard]] auto get(const ARGTYPE* arg) const {
+      return arg->value_from(tokens(arg));
+    }
+    // the stat of each value of arg that must_exist checked, in the order of
+    // tokens(arg) (only the last one for FileArg and DirectoryArg). Empty if
+    // the values need not exist or one of them failed. What arg->info() would
+    // return after the Parser::parse that stores values in the arguments.
+    [[nodiscard]] const std::vector<PathInfo>& paths(const ArgBase* arg) const;
+    [[nodiscard]] bool help_requested() const { return m_help; }
+    [[nodiscard]] bool completion_requested() const { return m_complete; }
+    // the subcommand token, empty if there is none. The tokens after it are
+    // left to Parser::subparser(subcommand()).
+    [[nodiscard]] std::string_view subcommand() const { return m_command; }
+    [[nodiscard]] ArgIter subcommand_begin() const { return m_command_begin; }
+    [[nodiscard]] ArgIter subcommand_end() const { return m_command_end; }
+    [[nodiscard]] bool ok() const { return m_error.empty() && m_diagnostics.empty(); }
+    // everything Parser::try_parse found wrong: the command line in order,
+    // then environment and config file values, then missing arguments. See
+    // Parser::describe for the messages.
+    [[nodiscard]] const std::pmr::vector<Diagnostic>& diagnostics() const { return m_diagnostics; }
+    // set by BatchParser for command lines that did not parse, the message
+    // of the first diagnostic or of the exception that stopped the parse
+    [[nodiscard]] const std::string& error() const { return m_error; }
+  private:
+    friend Parser;
+    friend class BatchParser;
+    void reset(std::size_t n_slots);
+    void store(const ArgBase& arg, std::string_view token) {
+      auto& values = m_values[arg.m_slot];
+      if (values.empty()) {
+        m_touched.push_back(arg.m_slot);
+        m_present[arg.m_slot / 64] |= std::uint64_t{1} << (arg.m_slot % 64);
+      }
+      values.push_back(token);
+    }
+    void store_all(const ArgBase& arg, ArgIter first, ArgIter last) {
+      if (first == last) {
+        return;
+      }
+      auto& values = m_values[arg.m_slot];
+      if (values.empty()) {
+        m_touched.push_back(arg.m_slot);
+        m_present[arg.m_slot / 64] |= std::uint64_t{1} << (arg.m_slot % 64);
+      }
+      values.insert(values.end(), first, last);
+    }
+    void store_paths(const ArgBase& arg, std::vector<PathInfo>&& infos) {
+      if (!infos.empty()) {
+        m_paths.emplace_back(arg.m_slot, std::move(infos));
+      }
+    }
+    ExpandedArgv m_argv;
+    // the config file of the Parser, if a missing argument needed it. Values
+    // from it point into its mapping.
+    std::optional<ConfigFile> m_config;
+    // the inner vectors allocate from the same resource as the outer one
+    std::pmr::vector<TokenList> m_values;
+    std::pmr::vector<std::uint64_t> m_present;
+    // slots with values, such that reset does not need to visit all of them
+    std::pmr::vector<std::size_t> m_touched;
+    // the stats of ArgBase::validate_stored by slot, only of the few
+    // arguments that took any
+    std::pmr::vector<std::pair<std::size_t, std::vector<PathInfo>>> m_paths;
+    std::pmr::vector<Diagnostic> m_diagnostics;
+    bool m_help{false};
+    bool m_complete{false};
+    std::string_view m_command;
+    ArgIter m_command_begin;
+    ArgIter m_command_end;
+    std::string m_error;
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "parse_result.cpp"
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+// Where the time of a parse goes. With TABPARSE_STATS defined (the CMake
+// option of the same name, on by default) the Parser measures each phase of
+// parsing and of help and completion rendering, but only once switched on:
+// by enable_parse_stats(true), or per invocation with the environment
+// variable TABPARSE_STATS set, which makes Parser::parse(argc, argv) print
+// the statistics as one JSON line to stderr. Switched off, every phase costs
+// one load of a flag. Without TABPARSE_STATS, PhaseTimer is empty and the
+// measurements compile to nothing.
+//
+// Allocations are only counted if the program includes count_allocations.h
+// in one of its translation units. Like the other numbers they are counted
+// per thread.
+#include "enumset.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+
+BETTER_ENUM(ParsePhase, int, Sanitize, ArgvCopy, Lookup, Conversion, Fallback, Required, Help, Completion, Parse)
+
+struct PhaseStats {
+  std::uint64_t calls{0};
+  std::uint64_t ns{0};
+  std::uint64_t allocations{0};
+};
+
+struct ParseStats {
+  std::array<PhaseStats, ParsePhase::_size()> phases{};
+  [[nodiscard]] PhaseStats& operator[](ParsePhase phase) { return phases[phase._to_index()]; }
+  [[nodiscard]] const PhaseStats& operator[](ParsePhase phase) const { return phases[phase._to_index()]; }
+  // {"Sanitize": {"calls": 1, "ns": 120, "allocations": 0}, ...}
+  void render_json(fmt::memory_buffer& out) const;
+};
+
+namespace parse_stats_detail {
+// counted by the operator new of count_allocations.h, per thread like
+// parse_stats(), such that parses on other threads do not add to them
+inline thread_local std::uint64_t allocations{0};
+// and the bytes they asked for, which tabparse_bench reports
+inline thread_local std::uint64_t allocated_bytes{0};
+}
+
+// the statistics gathered on the calling thread since the last reset
+[[nodiscard]] ParseStats& parse_stats();
+void reset_parse_stats();
+// initially whether TABPARSE_STATS is set in the environment
+void enable_parse_stats(bool enable);
+[[nodiscard]] bool parse_stats_enabled();
+// prints parse_stats() to stderr if TABPARSE_STATS is set in the environment
+void dump_parse_stats();
+
+#ifdef TABPARSE_STATS
+// adds the time and allocations of its lifetime to parse_stats()[phase]
+class PhaseTimer {
+  public:
+    explicit PhaseTimer(ParsePhase phase) : m_phase{phase}, m_enabled{parse_stats_enabled()} {
+      if (m_enabled) {
+        m_allocations = parse_stats_detail::allocations;
+        m_start = std::chrono::steady_clock::now();
+      }
+    }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+    ~PhaseTimer() {
+      if (m_enabled) {
+        auto elapsed = std::chrono::steady_clock::now() - m_start;
+        auto& stats = parse_stats()[m_phase];
+        ++stats.calls;
+        stats.ns += std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        stats.allocations += parse_stats_detail::allocations - m_allocations;
+      }
+    }
+  private:
+    ParsePhase m_phase;
+    bool m_enabled;
+    std::uint64_t m_allocations{0};
+    std::chrono::steady_clock::time_point m_start{};
+};
+#else
+class PhaseTimer {
+  public:
+    explicit constexpr PhaseTimer(ParsePhase /*unused*/) {}
+};
+#endif
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "parse_stats.cpp"
+#endif
@@ -1,28 +1,307 @@
 #pragma once
+#include "constraints.h"
+#include "flag_trie.h"
 #include "v_opt.h"
+#include "parse_result.h"
 #include <vector>
+#include <string>
 #include <string_view>
 #include <memory>
+#include <functional>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+#include <fmt/format.h>
 
 class Parser {
   private:
     std::vector<std::unique_ptr<ArgBase>> m_args;
     std::vector<std::unique_ptr<ArgBase>> m_pos;
-    std::unique_ptr<EndAwareArg> m_others;
+    std::unique_ptr<ArgBase> m_others;
+    // number of ParseResult slots handed out to arguments
+    std::size_t m_slots{0};
+    // required arguments, groups and dependencies over the slots. Behind a
+    // pointer, the arguments refer to it.
+    std::unique_ptr<Constraints> m_constraints{std::make_unique<Constraints>()};
+    template <typename ARGTYPE>
+    ARGTYPE* adopt(std::vector<std::unique_ptr<ArgBase>>& into, std::unique_ptr<ARGTYPE> arg);
+    // name -> flag argument, the keys are views of the m_name of the owned args
+    std::unordered_map<std::string_view, ArgBase*> m_index;
+    // the same names, to index in m_args, for abbreviations and suggestions
+    FlagTrie m_trie;
+    bool m_abbreviations{false};
+    // the flag token stands for, nullptr if none
+    [[nodiscard]] const ArgBase* find_flag(std::string_view token) const;
+    // " Did you mean NAME?" for a token that looks like a mistyped flag
+    [[nodiscard]] std::string suggestion(std::string_view token) const;
+    // the flag -c, nullptr if there is none
+    [[nodiscard]] const ArgBase* short_flag(char c) const;
+    // arg.takes_value() and arg.validate(token), switching on the
+    // ArgDispatch of arg instead of a virtual call where it can
+    [[nodiscard]] static bool value_expected(const ArgBase& arg);
+    [[nodiscard]] static std::optional<DiagnosticKind> validate_value(const ArgBase& arg, std::string_view token);
+    // reads a token in option position that starts with '-' and hands each
+    // flag it names to on_flag(arg, value). The value is set for --name=value
+    // and for a bundle -abc of single character flags whose last one takes
+    // the rest of the token (-j4). Returns false if the token names no flag,
+    // it is an operand then.
+    template <typename ON_FLAG>
+    bool read_flags(std::string_view token, ON_FLAG&& on_flag) const;
+    // kept up to date by addArg, such that printing the help needs no extra pass
+    std::size_t m_help_width{0};
+    std::size_t m_help_size{0};
+    void add_help_entry(const ArgBase& arg);
+    // the arguments with ArgBase::validate_stored checks, such as FileArg,
+    // such that read does not need to visit all arguments for them
+    std::vector<ArgBase*> m_stored_checks;
+    // values of VectorArg, MultiArg and of m_result
+    std::pmr::memory_resource* m_resource;
+    // of the last parse(argc, argv), the args may refer into its response files
+    ParseResult m_result;
+    std::size_t m_helper_threshold{default_helper_threshold};
+    // parse into result, noting what is wrong in result.m_diagnostics
+    void read(ArgIter begin, ArgIter end, ParseResult& result) const;
+    // see config_file, empty for none
+    std::string m_config_path;
+    // stores the values of the environment variables and of the config file
+    // for the arguments the command line did not give
+    void apply_fallbacks(ParseResult& result) const;
+    // see addSubcommand, the parser is built on first use
+    struct Subcommand {
+      std::string name;
+      std::string doc;
+      std::function<void(Parser&)> factory;
+      std::unique_ptr<Parser> parser;
+    };
+    std::vector<std::unique_ptr<Subcommand>> m_commands;
+    // name -> index in m_commands, the keys are views of the names
+    std::unordered_map<std::string_view, std::size_t> m_command_index;
+    std::size_t m_command_width{0};
+    // the subcommand of the last parse(argc, argv), nullptr if none
+    const Subcommand* m_selected{nullptr};
+    // parser of a subcommand, the complete keyword is an operand then
+    bool m_nested{false};
+    [[nodiscard]] const Subcommand* find_command(std::string_view token) const;
+    // runs the factory of command on the empty parser sub
+    void build_subparser(const Subcommand& command, Parser& sub) const;
+    // assigns the values of result to the arguments, or prints what it asks
+    // for, and then hands the tokens after a subcommand to its parser
+    void apply(const ParseResult& result, std::string_view appname);
+    // the _arguments call of a completion function, preceded by the
+    // functions function_name_COMMAND of the subcommands
+    void render_completion_body(fmt::memory_buffer& out, std::string_view function_name) const;
   public:
-    Parser() {
-      m_args.push_back(
-          std::make_unique<SwitchArg>("--help", "Print help message.")
-          );
+    // resource provides the storage of the parsed values. Passing a
+    // std::pmr::monotonic_buffer_resource makes every parse allocation a
+    // pointer bump, and frees all of them at once with the resource.
+    explicit Parser(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+        : m_resource{resource}, m_result{resource} {
+      auto* help = adopt(m_args, std::make_unique<SwitchArg>("--help", "Print help message."));
+      m_index.emplace(help->m_name, help);
+      m_trie.insert(help->m_name, 0);
+      add_help_entry(*help);
     }
+    // parses into the arguments, such that their ref() give the values.
+    // Arguments @path are replaced by the content of the response file path.
+    // A completion request is answered on stdout and ends the process.
     void parse(int argc, char *argv[]);
+    // leaves the Parser untouched and can be called concurrently
+    void parse(int argc, const char* const* argv, ParseResult& result) const;
+    void parse(ArgIter begin, ArgIter end, ParseResult& result) const;
+    // parse without exceptions for bad command lines: returns
+    // result.ok(), and result.diagnostics() lists everything that is wrong
+    // (bad values, unexpected arguments, missing ones), not just the first
+    // problem parse throws for
+    [[nodiscard]] bool try_parse(int argc, const char* const* argv, ParseResult& result) const;
+    [[nodiscard]] bool try_parse(ArgIter begin, ArgIter end, ParseResult& result) const;
+    // the message of a diagnostic of a ParseResult of this Parser
+    [[nodiscard]] std::string describe(const Diagnostic& diagnostic) const;
+    // for response files too large to hold at once: validates the tokens of
+    // path as values of the addOther argument and hands them to on_chunk,
+    // chunk_size at a time, see stream_response_file
+    void stream_others(const std::string& path, std::size_t chunk_size,
+                       const std::function<void(const std::vector<std::string_view>&)>& on_chunk) const;
     void sanitize();
+    // accept unambiguous prefixes of long flags (--build-d for --build-dir),
+    // as getopt_long does. Off by default, such tokens are positional
+    // arguments otherwise.
+    void allow_abbreviations(bool allow) { m_abbreviations = allow; }
+    // the file (see ConfigFile) arguments with a config_key fall back to,
+    // after the command line and their environment variable. It is only
+    // read if one of them is not on the command line.
+    void config_file(std::string path) { m_config_path = std::move(path); }
     template <typename ARGTYPE, typename ...OTHERARGS>
     [[nodiscard]] ARGTYPE* addArg(std::string_view name, typename ARGTYPE::type default_value, std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs);
     template <typename ARGTYPE, typename ...OTHERARGS>
     [[nodiscard]] ARGTYPE* addPosArg(typename ARGTYPE::type default_value, std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs);
     template <typename BASE_ARG, typename ...OTHERARGS>
     [[nodiscard]] MultiArg<BASE_ARG>* addOther(std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs);
-    void print_help(std::string_view appname);
-    void print_completion(std::string_view appname);
+    // at most one, exactly one or at least one of members may be given.
+    // The completion does not offer the others once one of an at most one
+    // (or exactly one) group is on the command line.
+    void addGroup(GroupKind kind, std::initializer_list<const ArgBase*> members);
+    // arg may only be given together with all of needed
+    void addDependency(const ArgBase* arg, std::initializer_list<const ArgBase*> needed);
+    // git style subcommands: the first operand names one, and the tokens
+    // after it are parsed by a Parser that factory registers the arguments
+    // of. Only the factory of the selected subcommand runs (print_completion
+    // runs all of them), so a tool with many subcommands builds one per run.
+    // Flags before the subcommand belong to this Parser, which can not have
+    // positional arguments then.
+    void addSubcommand(std::string_view name, std::string_view doc, std::function<void(Parser&)> factory);
+    // the parser of subcommand name, built on first use. To parse the tokens
+    // ParseResult::subcommand_begin/end of a const parse. Not thread safe.
+    [[nodiscard]] Parser& subparser(std::string_view name);
+    // of the last parse(argc, argv), empty if it named none
+    [[nodiscard]] std::string_view subcommand() const { return m_selected ? std::string_view{m_selected->name} : std::string_view{}; }
+    // to stdout
+    void print_help(std::string_view appname) const;
+    void print_help(std::string_view appname, int fd) const;
+    void print_help(std::string_view appname, std::string_view path) const;
+    // width 0 disables line wrapping
+    void render_help(fmt::memory_buffer& out, std::string_view appname, std::size_t width) const;
+    // to the file _appname in the working directory
+    void print_completion(std::string_view appname) const;
+    void print_completion(std::string_view appname, int fd) const;
+    void print_completion(std::string_view appname, std::string_view path) const;
+    void render_completion(fmt::memory_buffer& out, std::string_view appname) const;
+    // choice lists longer than this are not spelled out in the _arguments
+    // spec, which zsh parses on every TAB, but in a function that builds
+    // them once per shell, see append_choice_function
+    static constexpr std::size_t default_helper_threshold = 64;
+    void completion_helper_threshold(std::size_t n_choices) { m_helper_threshold = n_choices; }
+
+    // Dynamic completion: instead of describing all arguments up front, the
+    // completion function asks the program at TAB time
+    //
+    //   app __tabparse_complete CURRENT WORDS...
+    //
+    // with zsh's $CURRENT and $words. parse() answers with the kind of value
+    // expected at words[CURRENT] on the first line (describe TITLE, files
+    // PATTERN, directories or message TEXT), followed by the matching
+    // value:description lines for describe. Nothing but the argument
+    // registration has to run before parse(), programs with a costly startup
+    // can test completion_request(argc, argv) and skip the rest of it.
+    static constexpr std::string_view complete_keyword = dynamic_complete_keyword;
+    [[nodiscard]] static bool completion_request(int argc, const char* const* argv);
+    // the answer for words[current], words not including the program name
+    void render_candidates(fmt::memory_buffer& out, ArgIter begin, ArgIter end, std::size_t current) const;
+    // a completion function that forwards to the program, see above
+    void render_dynamic_completion(fmt::memory_buffer& out, std::string_view appname) const;
+    // to the file _appname in the working directory
+    void print_dynamic_completion(std::string_view appname) const;
+
+    // Generation at build time: with
+    //
+    //   app __tabparse_generate NAME PATH
+    //
+    // parse() runs update_completion(NAME, PATH) and exits, so nothing but
+    // the argument registration runs. See tabparse_add_completion in
+    // cmake/tabparseCompletion.cmake.
+    static constexpr std::string_view generate_keyword = "__tabparse_generate";
+    [[nodiscard]] static bool generation_request(int argc, const char* const* argv);
+    // writes the completion function to path, unless the file there already
+    // is the one of the same schema, as told by the fingerprint in its second
+    // line. Returns whether it wrote. An untouched file keeps the build steps
+    // that depend on it from running again.
+    bool update_completion(std::string_view appname, std::string_view path) const;
+  private:
+    [[noreturn]] void answer_completion(int argc, const char* const* argv) const;
+    [[noreturn]] void answer_generation(int argc, const char* const* argv) const;
 };
+
+// in the header, such that the parse loop can inline them in shared builds
+inline bool Parser::value_expected(const ArgBase& arg) {
+  switch (arg.m_dispatch) {
+    case ArgDispatch::Virtual:
+      return arg.takes_value();
+    case ArgDispatch::Switch:
+      return false;
+    default:
+      return true;
+  }
+}
+
+inline std::optional<DiagnosticKind> Parser::validate_value(const ArgBase& arg, std::string_view token) {
+  // the known classes without a virtual call
+  switch (arg.m_dispatch) {
+    case ArgDispatch::Switch:
+    case ArgDispatch::String:
+      return std::nullopt;
+    case ArgDispatch::Int:
+      return IntArg::validate_number(token);
+    case ArgDispatch::Int64:
+      return Int64Arg::validate_number(token);
+    case ArgDispatch::UInt:
+      return UIntArg::validate_number(token);
+    case ArgDispatch::Double:
+      return DoubleArg::validate_number(token);
+    case ArgDispatch::Virtual:
+      break;
+  }
+  return arg.validate(token);
+}
+
+template <typename ARGTYPE>
+ARGTYPE* Parser::adopt(std::vector<std::unique_ptr<ArgBase>>& into, std::unique_ptr<ARGTYPE> arg) {
+  if (&into != &m_args && !m_commands.empty()) {
+    throw std::invalid_argument("a parser with subcommands can not have positional arguments.");
+  }
+  arg->m_slot = m_slots++;
+  arg->m_constraints = m_constraints.get();
+  arg->m_dispatch = dispatch_of<ARGTYPE>();
+  m_constraints->add(*arg, &into == &m_pos);
+  static_cast<ArgBase&>(*arg).use_resource(m_resource);
+  if constexpr (has_value_validation<ARGTYPE>::value) {
+    m_stored_checks.push_back(arg.get());
+  }
+  into.push_back(std::move(arg));
+  return static_cast<ARGTYPE*>(into.back().get());
+}
+
+template <typename ARGTYPE, typename ...OTHERARGS>
+ARGTYPE*
+Parser::addArg(std::string_view name, typename ARGTYPE::type default_value,
+               std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
+  if (m_index.end() != m_index.find(name)) {
+    throw std::invalid_argument(fmt::format("option with name {} already exists", name));
+  }
+  if (name[0] != '-') {
+    throw std::invalid_argument(fmt::format("flag arguments should start with - or --. {} does not.", name));
+  }
+  auto thearg = adopt(m_args, std::make_unique<ARGTYPE>(name, std::move(default_value), shortdoc, doc, std::forward<OTHERARGS>(otherargs)...));
+  m_index.emplace(thearg->m_name, thearg);
+  m_trie.insert(thearg->m_name, std::uint32_t(m_args.size() - 1));
+  add_help_entry(*thearg);
+  return thearg;
+}
+
+template <typename ARGTYPE, typename ...OTHERARGS>
+ARGTYPE*
+Parser::addPosArg(typename ARGTYPE::type default_value,
+                  std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
+  return adopt(m_pos, std::make_unique<ARGTYPE>(fmt::format("{}", m_pos.size()+1), std::move(default_value), shortdoc, doc, std::forward<OTHERARGS>(otherargs)...));
+}
+
+template <typename BASE_ARG, typename ...OTHERARGS>
+MultiArg<BASE_ARG>* Parser::addOther(std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
+  if (!m_commands.empty()) {
+    throw std::invalid_argument("a parser with subcommands can not have positional arguments.");
+  }
+  m_others = std::make_unique<MultiArg<BASE_ARG>>("*", typename BASE_ARG::type{}, shortdoc, doc, std::forward<OTHERARGS>(otherargs)...);
+  m_others->m_slot = m_slots++;
+  m_others->m_constraints = m_constraints.get();
+  m_constraints->add(*m_others, false);
+  m_others->use_resource(m_resource);
+  if constexpr (has_value_validation<BASE_ARG>::value) {
+    m_stored_checks.push_back(m_others.get());
+  }
+  return static_cast<MultiArg<BASE_ARG>*>(m_others.get());
+}
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "parser.cpp"
+#endif
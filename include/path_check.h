@@ -0,0 +1,91 @@
+#pragma once
+// Opt-in validation of FileArg and DirectoryArg values: the glob pattern a
+// FileArg passes to zsh's _files -g, compiled once and matched against each
+// value, and a stat of each value that checks it exists and is of the right
+// type. Many values (MultiArg<FileArg> with paths from a response file) are
+// stat-ed in chunks on several threads, and the results are kept, so the
+// program does not need to stat again.
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <sys/stat.h>
+#include <vector>
+
+// the subset of zsh glob syntax completion patterns use: * ? [abc] [a-z]
+// [!abc] and alternatives (cpp|h), as in *.(cpp|h). Without a / in the
+// pattern only the last component of a path is matched, as _files -g does.
+class GlobPattern {
+  public:
+    GlobPattern() = default;
+    explicit GlobPattern(std::string_view pattern);
+    [[nodiscard]] bool matches(std::string_view path) const;
+  private:
+    struct Op {
+      enum Kind : std::uint8_t { Literal, Any, Star, Class } kind;
+      std::string literal;
+      std::bitset<256> set;
+    };
+    using Sequence = std::vector<Op>;
+    [[nodiscard]] static bool matches(const Sequence& ops, std::string_view text);
+    // one sequence per combination of alternatives
+    std::vector<Sequence> m_alternatives;
+    bool m_whole_path{false};
+};
+
+// the kinds of path values, file meaning anything but a directory
+enum class PathKind : std::uint8_t { Any, File, Directory };
+
+struct PathInfo {
+  std::string_view path;
+  struct stat status;
+};
+
+// stats [first, last) in chunks on up to n_threads threads (0 for one per
+// core, only one for few paths) and throws std::invalid_argument for the first path, in command
+// line order, that does not exist or is not of kind
+[[nodiscard]] std::vector<PathInfo> stat_paths(const std::string_view* first, const std::string_view* last, PathKind kind,
+                                               unsigned n_threads);
+
+// the error check_paths gives a path that exists but is not of the kind
+inline constexpr int path_wrong_kind = -1;
+
+// stat_paths without the exception, for Parser::try_parse: per path 0 if it
+// is fine, path_wrong_kind, or the errno of its stat. The stats go to infos,
+// those of paths that are not fine are unspecified.
+[[nodiscard]] std::vector<int> check_paths(const std::string_view* first, const std::string_view* last, PathKind kind,
+                                           unsigned n_threads, std::vector<PathInfo>& infos);
+
+// what FileArg and DirectoryArg keep of must_exist
+class PathValues {
+  public:
+    // the stat of each value of the last parse(argc, argv), in the order of
+    // the values, empty without must_exist. The paths are views of the
+    // tokens, as the values of a FileViewArg.
+    [[nodiscard]] const std::vector<PathInfo>& info() const { return m_info; }
+    // the check_paths errors of the values, empty if they need not exist.
+    // Their stats go to infos if all of them are fine, the Parser keeps them
+    // in the ParseResult and hands them to info() instead of a second stat.
+    [[nodiscard]] std::vector<int> check_values(const std::string_view* first, const std::string_view* last,
+                                                std::vector<PathInfo>& infos) const {
+      if (!m_must_exist || first == last) {
+        return {};
+      }
+      auto errors = check_paths(first, last, m_kind, 0, infos);
+      if (std::any_of(errors.begin(), errors.end(), [](int error) { return error != 0; })) {
+        infos.clear();
+      }
+      return errors;
+    }
+  protected:
+    explicit PathValues(PathKind kind) : m_kind{kind} {}
+    PathKind m_kind;
+    bool m_must_exist{false};
+    std::vector<PathInfo> m_info;
+};
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "path_check.cpp"
+#endif
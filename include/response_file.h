@@ -0,0 +1,58 @@
+#pragma once
+#include "v_opt.h"
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A response file (@path on the command line) mapped into memory and split
+// into NUL terminated tokens in place. The mapping is private, the file itself
+// is not modified. Tokens stay valid for the lifetime of the ResponseFile.
+//
+// Tokens are separated by whitespace. Single quotes preserve everything up to
+// the closing quote, elsewhere a backslash escapes the character after it.
+// Double quotes group whitespace into a token.
+class ResponseFile {
+  public:
+    explicit ResponseFile(const std::string& path);
+    ResponseFile(ResponseFile&& other) noexcept;
+    ResponseFile& operator=(ResponseFile&& other) noexcept;
+    ResponseFile(const ResponseFile&) = delete;
+    ResponseFile& operator=(const ResponseFile&) = delete;
+    ~ResponseFile();
+    [[nodiscard]] const std::vector<const char*>& tokens() const { return m_tokens; }
+  private:
+    char* m_data{nullptr};
+    std::size_t m_mapped{0};
+    std::vector<const char*> m_tokens;
+};
+
+// A command line with all @path arguments replaced by the content of the
+// respective files (recursively). Without any @path it refers to the original
+// argv and copies nothing. Arguments starting with @ that do not name a
+// readable file are kept as they are.
+class ExpandedArgv {
+  public:
+    void expand(int argc, const char* const* argv);
+    [[nodiscard]] ArgIter begin() const { return ArgIter{m_begin}; }
+    [[nodiscard]] ArgIter end() const { return ArgIter{m_end}; }
+  private:
+    void append(int argc, const char* const* argv, int depth);
+    const char* const* m_begin{nullptr};
+    const char* const* m_end{nullptr};
+    std::vector<const char*> m_argv;
+    std::vector<ResponseFile> m_files;
+};
+
+// Tokenizes path with the ResponseFile rules, but hands the tokens to on_chunk
+// in chunks of (at most) chunk_size instead of keeping them. Pages of the file
+// that have been tokenized are released again, so memory stays bounded for
+// files of any size. The views are only valid during the call to on_chunk.
+// Nested @path tokens are handed out as they are.
+void stream_response_file(const std::string& path, std::size_t chunk_size,
+                          const std::function<void(const std::vector<std::string_view>&)>& on_chunk);
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "response_file.cpp"
+#endif
@@ -0,0 +1,522 @@
+#pragma once
+// Compile-time alternative to registering arguments with Parser::addArg.
+//
+// When the set of options is known at compile time, it can be spelled out as a
+// constexpr StaticSchema. The name lookup table, the mask of required
+// arguments and the body of the zsh completion function are then all computed
+// by the compiler, and StaticParser needs neither heap allocations nor any
+// other work at startup before it can parse:
+//
+//   constexpr std::string_view modes[] = {"demonstrate", "party", "lazy"};
+//   inline constexpr auto schema = make_schema(
+//       StaticArg::Directory("--build-dir", ".", "BUILDDIR", "specify the build directory").required(true),
+//       StaticArg::Int("-j", 42, "CONCURRENCY", "specify the concurrency level"),
+//       StaticArg::StringChoice("--mode", "demonstrate", "MODE", "specify running mode", modes),
+//       StaticArg::File("sources", "", "FILE", "the input files", "*.cpp").others());
+//
+//   StaticParser<schema> p;
+//   p.parse(argc, argv);
+//   int j = p.get<p.index("-j")>();
+#include "v_opt.h"
+#include "output.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <string_view>
+#include <vector>
+#include <fmt/format.h>
+#include <unistd.h>
+
+BETTER_ENUM(ArgRole, int, Flag, Positional, Others)
+
+// Description of one argument, the compile-time counterpart of the ArgBase
+// hierarchy. Positional and overflow arguments have a name as well, which is
+// only used to look them up with StaticParser::index.
+struct StaticArg {
+  ArgKind kind;
+  ArgRole role;
+  std::string_view name;
+  std::string_view shortdoc;
+  std::string_view doc;
+  std::string_view default_string{};
+  long default_int{0};
+  std::string_view pattern{};
+  const std::string_view* choices{nullptr};
+  const std::string_view* descriptions{nullptr};
+  std::size_t n_choices{0};
+  bool is_required{false};
+  bool repeated{false};
+
+  static constexpr StaticArg Switch(std::string_view name, std::string_view doc) {
+    return {ArgKind::Switch, ArgRole::Flag, name, "", doc};
+  }
+  static constexpr StaticArg Int(std::string_view name, long default_value, std::string_view shortdoc, std::string_view doc) {
+    StaticArg retval{ArgKind::Int, ArgRole::Flag, name, shortdoc, doc};
+    retval.default_int = default_value;
+    return retval;
+  }
+  static constexpr StaticArg String(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc) {
+    return {ArgKind::String, ArgRole::Flag, name, shortdoc, doc, default_value};
+  }
+  static constexpr StaticArg File(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc, std::string_view pattern) {
+    StaticArg retval{ArgKind::File, ArgRole::Flag, name, shortdoc, doc, default_value};
+    retval.pattern = pattern;
+    return retval;
+  }
+  static constexpr StaticArg Directory(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc) {
+    return {ArgKind::Directory, ArgRole::Flag, name, shortdoc, doc, default_value};
+  }
+  // choices (and descriptions) must have static storage duration
+  template <std::size_t N>
+  static constexpr StaticArg StringChoice(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc,
+                                          const std::string_view (&choices)[N]) {
+    StaticArg retval{ArgKind::StringChoice, ArgRole::Flag, name, shortdoc, doc, default_value};
+    retval.choices = choices;
+    retval.n_choices = N;
+    return retval;
+  }
+  template <std::size_t N>
+  static constexpr StaticArg StringChoice(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc,
+                                          const std::string_view (&choices)[N], const std::string_view (&descriptions)[N]) {
+    StaticArg retval = StringChoice(name, default_value, shortdoc, doc, choices);
+    retval.descriptions = descriptions;
+    return retval;
+  }
+
+  constexpr StaticArg required(bool req) const {
+    StaticArg retval = *this;
+    retval.is_required = req;
+    return retval;
+  }
+  // like VectorArg: the flag may be given several times
+  constexpr StaticArg vector() const {
+    StaticArg retval = *this;
+    retval.repeated = true;
+    return retval;
+  }
+  // like Parser::addPosArg
+  constexpr StaticArg positional() const {
+    StaticArg retval = *this;
+    retval.role = ArgRole::Positional;
+    return retval;
+  }
+  // like Parser::addOther
+  constexpr StaticArg others() const {
+    StaticArg retval = *this;
+    retval.role = ArgRole::Others;
+    retval.repeated = true;
+    return retval;
+  }
+};
+
+template <std::size_t N>
+struct StaticSchema {
+  std::array<StaticArg, N> args;
+};
+
+// like the Parser constructor, every schema starts with --help
+template <typename... ARGS>
+constexpr StaticSchema<sizeof...(ARGS) + 1> make_schema(ARGS... args) {
+  return {{{StaticArg::Switch("--help", "Print help message."), args...}}};
+}
+
+namespace static_schema_detail {
+constexpr std::uint32_t hash(std::string_view s) {
+  // FNV-1a, the same function is used at compile time and at runtime
+  std::uint32_t h = 2166136261u;
+  for (char c : s) {
+    h = (h ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  return h;
+}
+
+constexpr std::size_t lookup_size(std::size_t n) {
+  std::size_t size = 2;
+  while (size < 2 * n) {
+    size *= 2;
+  }
+  return size;
+}
+
+// open addressing table of index+1 into the schema, 0 marks an empty slot
+template <std::size_t N>
+constexpr std::array<std::uint32_t, lookup_size(N)> build_lookup(const StaticSchema<N>& schema) {
+  std::array<std::uint32_t, lookup_size(N)> table{};
+  constexpr std::size_t mask = lookup_size(N) - 1;
+  for (std::size_t i = 0; i < N; ++i) {
+    const auto& arg = schema.args[i];
+    if (arg.role != +ArgRole::Flag) {
+      continue;
+    }
+    if (arg.name.empty() || arg.name[0] != '-') {
+      throw std::invalid_argument("flag arguments should start with - or --.");
+    }
+    std::size_t slot = hash(arg.name) & mask;
+    while (table[slot] != 0) {
+      if (schema.args[table[slot] - 1].name == arg.name) {
+        throw std::invalid_argument("option name registered twice.");
+      }
+      slot = (slot + 1) & mask;
+    }
+    table[slot] = std::uint32_t(i + 1);
+  }
+  return table;
+}
+
+// same semantics as Parser::sanitize: positional arguments before a required
+// one are required as well
+template <std::size_t N>
+constexpr std::array<std::uint64_t, (N + 63) / 64> build_required(const StaticSchema<N>& schema) {
+  std::array<std::uint64_t, (N + 63) / 64> mask{};
+  bool later_positional_required = false;
+  for (std::size_t i = N; i > 0; --i) {
+    const auto& arg = schema.args[i - 1];
+    bool req = arg.is_required;
+    if (arg.role == +ArgRole::Positional) {
+      later_positional_required = later_positional_required || req;
+      req = later_positional_required;
+    }
+    if (req) {
+      mask[(i - 1) / 64] |= std::uint64_t{1} << ((i - 1) % 64);
+    }
+  }
+  return mask;
+}
+
+struct CountingSink {
+  std::size_t size{0};
+  constexpr void put(std::string_view s) { size += s.size(); }
+};
+
+template <std::size_t LENGTH>
+struct FixedString {
+  std::array<char, LENGTH + 1> data{};
+  std::size_t size{0};
+  constexpr void put(std::string_view s) {
+    for (char c : s) {
+      data[size++] = c;
+    }
+  }
+  constexpr std::string_view view() const { return {data.data(), size}; }
+};
+
+template <typename SINK>
+constexpr void put_number(SINK& sink, std::size_t n) {
+  char digits[20] = {};
+  std::size_t len = 0;
+  do {
+    digits[len++] = char('0' + n % 10);
+    n /= 10;
+  } while (n > 0);
+  for (; len > 0; --len) {
+    sink.put(std::string_view{&digits[len - 1], 1});
+  }
+}
+
+// mirrors the completion_entry implementations of the argument classes
+template <typename SINK>
+constexpr void put_entry(SINK& sink, const StaticArg& arg, std::size_t position) {
+  bool skip_description = arg.role != +ArgRole::Flag;
+  if (arg.role == +ArgRole::Flag) {
+    if (arg.repeated) {
+      sink.put("*");
+    }
+    sink.put(arg.name);
+  } else if (arg.role == +ArgRole::Positional) {
+    put_number(sink, position);
+  } else {
+    sink.put("*");
+  }
+  if (!skip_description) {
+    sink.put("[");
+    sink.put(arg.doc);
+    sink.put("]");
+  }
+  if (arg.kind == +ArgKind::Switch) {
+    return;
+  }
+  sink.put(":");
+  sink.put(arg.shortdoc);
+  sink.put(":");
+  if (arg.kind == +ArgKind::File) {
+    sink.put(" _files -g '");
+    sink.put(arg.pattern);
+    sink.put("'");
+  } else if (arg.kind == +ArgKind::Directory) {
+    sink.put(" _files -/");
+  } else if (arg.kind == +ArgKind::StringChoice) {
+    sink.put(arg.descriptions ? "((" : "(");
+    for (std::size_t i = 0; i < arg.n_choices; ++i) {
+      sink.put(arg.choices[i]);
+      if (arg.descriptions) {
+        sink.put("\\:'");
+        sink.put(arg.descriptions[i]);
+        sink.put("'");
+      }
+      if (i + 1 < arg.n_choices) {
+        sink.put(" ");
+      }
+    }
+    sink.put(arg.descriptions ? "))" : ")");
+  }
+}
+
+// the same layout Parser::print_completion writes: flags, positionals, others
+template <typename SINK>
+constexpr void put_arguments(SINK& sink, const StaticArg* first, const StaticArg* last) {
+  sink.put("_arguments");
+  std::size_t position = 0;
+  for (auto role : {+ArgRole::Flag, +ArgRole::Positional, +ArgRole::Others}) {
+    for (const StaticArg* arg = first; arg != last; ++arg) {
+      if (arg->role != role) {
+        continue;
+      }
+      if (role == +ArgRole::Positional) {
+        ++position;
+      }
+      sink.put(" \\\n  \"");
+      put_entry(sink, *arg, position);
+      sink.put("\"");
+    }
+  }
+  sink.put("\n");
+}
+
+template <typename SINK, std::size_t N>
+constexpr void put_arguments(SINK& sink, const StaticSchema<N>& schema) {
+  put_arguments(sink, schema.args.data(), schema.args.data() + N);
+}
+
+// for the descriptors that are only known at runtime
+struct BufferSink {
+  fmt::memory_buffer& out;
+  void put(std::string_view s) { out.append(s.data(), s.data() + s.size()); }
+};
+
+// throws std::invalid_argument if value does not suit arg
+inline void check_value(const StaticArg& arg, std::string_view value) {
+  if (arg.kind == +ArgKind::Int) {
+    (void)parse_number<long>(value);
+  } else if (arg.kind == +ArgKind::StringChoice) {
+    if (std::find(arg.choices, arg.choices + arg.n_choices, value) == arg.choices + arg.n_choices) {
+      throw std::invalid_argument(fmt::format("{} is not a valid choice for {}.", value, arg.name));
+    }
+  }
+}
+
+// the same layout Parser::print_help writes, required is the mask of
+// required arguments (see build_required)
+inline void render_help(fmt::memory_buffer& out, std::string_view appname, const StaticArg* first, const StaticArg* last,
+                        const std::uint64_t* required, std::size_t width) {
+  std::size_t max_length = 0;
+  for (const StaticArg* arg = first; arg != last; ++arg) {
+    if (arg->role == +ArgRole::Flag) {
+      max_length = std::max(max_length, arg->name.size() + 1 + arg->shortdoc.size());
+    }
+  }
+  auto outiter = std::back_inserter(out);
+  fmt::format_to(outiter, "USAGE: {}", appname);
+  for (std::size_t i = 0; first + i != last; ++i) {
+    const auto& arg = first[i];
+    bool req = required[i / 64] & (std::uint64_t{1} << (i % 64));
+    if (arg.role == +ArgRole::Flag && req) {
+      fmt::format_to(outiter, " {} {}", arg.name, arg.shortdoc);
+    } else if (arg.role == +ArgRole::Positional) {
+      fmt::format_to(outiter, req ? " {}" : " [{}]", arg.shortdoc);
+    }
+  }
+  fmt::format_to(outiter, "\n\n");
+  for (const StaticArg* arg = first; arg != last; ++arg) {
+    if (arg->role == +ArgRole::Flag) {
+      fmt::format_to(outiter, "  {} {:<{}}", arg->name, arg->shortdoc, max_length + 2 - arg->name.size());
+      append_wrapped(out, arg->doc, max_length + 5, width);
+      out.push_back('\n');
+    }
+  }
+}
+
+template <std::size_t N>
+constexpr std::size_t arguments_length(const StaticSchema<N>& schema) {
+  CountingSink sink;
+  put_arguments(sink, schema);
+  return sink.size;
+}
+}
+
+// Everything derived from a schema at compile time.
+template <const auto& SCHEMA>
+struct StaticTables {
+  static constexpr std::size_t size = SCHEMA.args.size();
+  static constexpr auto lookup = static_schema_detail::build_lookup(SCHEMA);
+  static constexpr auto required = static_schema_detail::build_required(SCHEMA);
+  static constexpr auto arguments = [] {
+    static_schema_detail::FixedString<static_schema_detail::arguments_length(SCHEMA)> body;
+    static_schema_detail::put_arguments(body, SCHEMA);
+    return body;
+  }();
+  // the `_arguments ...` call of the completion function
+  static constexpr std::string_view completion_body = arguments.view();
+
+  static constexpr std::size_t index(std::string_view name) {
+    for (std::size_t i = 0; i < size; ++i) {
+      if (SCHEMA.args[i].name == name) {
+        return i;
+      }
+    }
+    throw std::invalid_argument("no argument with that name in the schema.");
+  }
+  // index of a flag in the schema, or size if the token is none
+  static std::size_t find_flag(std::string_view token) {
+    constexpr std::size_t mask = lookup.size() - 1;
+    for (std::size_t slot = static_schema_detail::hash(token) & mask; lookup[slot] != 0; slot = (slot + 1) & mask) {
+      if (SCHEMA.args[lookup[slot] - 1].name == token) {
+        return lookup[slot] - 1;
+      }
+    }
+    return size;
+  }
+};
+
+// Parses a command line against a compile-time schema. Values are views into
+// argv, only arguments that are repeated need (heap) storage while parsing.
+template <const auto& SCHEMA>
+class StaticParser {
+  public:
+    using tables = StaticTables<SCHEMA>;
+    static constexpr std::size_t index(std::string_view name) { return tables::index(name); }
+
+    void parse(int argc, char* argv[]) {
+      const ArgIter begin{argv + 1};
+      const ArgIter end{argv + argc};
+      std::size_t next_positional = 0;
+      bool had_operand = false;
+      for (auto iter = begin; iter != end;) {
+        std::size_t idx = tables::find_flag(*iter);
+        // --help and complete only where Parser takes them: --help in place
+        // of a flag, not as a value, complete as the first operand
+        if (idx == 0) {
+          print_help(argv[0]);
+          return;
+        }
+        if (idx == tables::size && !had_operand && *iter == "complete") {
+          print_completion(argv[0]);
+          return;
+        }
+        if (idx != tables::size) {
+          ++iter;
+          if (SCHEMA.args[idx].kind == +ArgKind::Switch) {
+            m_values[idx] = "1";
+            set_present(idx);
+            continue;
+          }
+          if (iter == end) {
+            throw std::invalid_argument(fmt::format("missing value for {}.", SCHEMA.args[idx].name));
+          }
+          store(idx, *iter++);
+          continue;
+        }
+        had_operand = true;
+        next_positional = next_slot(next_positional, ArgRole::Positional);
+        if (next_positional != tables::size) {
+          store(next_positional, *iter++);
+          ++next_positional;
+          continue;
+        }
+        std::size_t others = next_slot(0, ArgRole::Others);
+        if (others == tables::size) {
+          throw std::invalid_argument(fmt::format("no more positional arguments expected, received {}.", *iter));
+        }
+        // the remaining tokens are all overflow values, also those that look
+        // like flags. Unlike Parser, flags can not follow the first of them.
+        for (; iter != end; ++iter) {
+          store(others, *iter);
+        }
+      }
+      for (std::size_t w = 0; w < tables::required.size(); ++w) {
+        std::uint64_t missing = tables::required[w] & ~m_present[w];
+        if (missing) {
+          const auto& arg = SCHEMA.args[w * 64 + std::size_t(__builtin_ctzll(missing))];
+          throw std::invalid_argument(fmt::format("required argument {} not used.",
+                                                  arg.role == +ArgRole::Flag ? arg.name : arg.shortdoc));
+        }
+      }
+    }
+
+    [[nodiscard]] bool present(std::size_t idx) const {
+      return m_present[idx / 64] & (std::uint64_t{1} << (idx % 64));
+    }
+
+    // bool for switches, long for integers, std::string_view for all string
+    // kinds, and a vector of those for repeated arguments
+    template <std::size_t IDX>
+    [[nodiscard]] decltype(auto) get() const {
+      constexpr const StaticArg& arg = SCHEMA.args[IDX];
+      if constexpr (arg.repeated) {
+        if constexpr (arg.kind == +ArgKind::Int) {
+          std::vector<long> retval;
+          retval.reserve(m_repeated[IDX].size());
+          for (auto v : m_repeated[IDX]) {
+            retval.push_back(parse_number<long>(v));
+          }
+          return retval;
+        } else {
+          return (m_repeated[IDX]);
+        }
+      } else if constexpr (arg.kind == +ArgKind::Switch) {
+        return present(IDX);
+      } else if constexpr (arg.kind == +ArgKind::Int) {
+        return present(IDX) ? parse_number<long>(m_values[IDX]) : arg.default_int;
+      } else {
+        return present(IDX) ? m_values[IDX] : arg.default_string;
+      }
+    }
+
+    void print_completion(std::string_view appname) const {
+      if (appname.substr(0, 2) == "./") {
+        appname.remove_prefix(2);
+      }
+      fmt::memory_buffer out;
+      out.reserve(appname.size() + 12 + tables::completion_body.size());
+      fmt::format_to(std::back_inserter(out), "#compdef {}\n\n{}", appname, tables::completion_body);
+      write_buffer(fmt::format("_{}", appname), {out.data(), out.size()});
+    }
+
+    void print_help(std::string_view appname) const {
+      fmt::memory_buffer out;
+      static_schema_detail::render_help(out, appname, SCHEMA.args.data(), SCHEMA.args.data() + tables::size,
+                                        tables::required.data(), terminal_width(STDOUT_FILENO));
+      write_buffer(STDOUT_FILENO, {out.data(), out.size()});
+    }
+
+  private:
+    std::size_t next_slot(std::size_t from, ArgRole role) const {
+      for (; from < tables::size; ++from) {
+        if (SCHEMA.args[from].role == role) {
+          return from;
+        }
+      }
+      return tables::size;
+    }
+
+    void store(std::size_t idx, std::string_view value) {
+      const auto& arg = SCHEMA.args[idx];
+      static_schema_detail::check_value(arg, value);
+      set_present(idx);
+      if (arg.repeated) {
+        m_repeated[idx].push_back(value);
+      } else {
+        m_values[idx] = value;
+      }
+    }
+
+    void set_present(std::size_t idx) {
+      m_present[idx / 64] |= std::uint64_t{1} << (idx % 64);
+    }
+
+    std::array<std::string_view, tables::size> m_values{};
+    std::array<std::vector<std::string_view>, tables::size> m_repeated{};
+    std::array<std::uint64_t, tables::required.size()> m_present{};
+};
@@ -3,78 +3,335 @@
 #include <vector>
 #include <initializer_list>
 #include <fmt/format.h>
+#include <fmt/ranges.h>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
 #include <string_view>
 #include <stdexcept>
 #include <type_traits>
 #include <utility>
+#include <iterator>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <optional>
+#include "choice_cache.h"
 #include "enumset.h"
+#include "numeric.h"
+#include "output.h"
+#include "path_check.h"
 
+class ArgBase;
+class Constraints;
 class Parser;
-using ArgIter = decltype(std::declval<std::vector<std::string>>().begin());
+class ParseResult;
+
+// the tokens a parse found for one argument
+using TokenList = std::pmr::vector<std::string_view>;
+
+// Walks an argv-style array of NUL terminated strings and hands out views into
+// it, such that parsing never has to copy the command line.
+class ArgIter {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const std::string_view*;
+    using reference = std::string_view;
+    ArgIter() = default;
+    explicit ArgIter(const char* const* pos) : m_pos{pos} {}
+    [[nodiscard]] std::string_view operator*() const { return *m_pos; }
+    [[nodiscard]] std::string_view operator[](difference_type n) const { return m_pos[n]; }
+    [[nodiscard]] const char* c_str() const { return *m_pos; }
+    ArgIter& operator++() { ++m_pos; return *this; }
+    ArgIter operator++(int) { return ArgIter{m_pos++}; }
+    ArgIter& operator--() { --m_pos; return *this; }
+    ArgIter operator--(int) { return ArgIter{m_pos--}; }
+    ArgIter& operator+=(difference_type n) { m_pos += n; return *this; }
+    ArgIter& operator-=(difference_type n) { m_pos -= n; return *this; }
+    [[nodiscard]] ArgIter operator+(difference_type n) const { return ArgIter{m_pos + n}; }
+    [[nodiscard]] ArgIter operator-(difference_type n) const { return ArgIter{m_pos - n}; }
+    [[nodiscard]] difference_type operator-(const ArgIter& other) const { return m_pos - other.m_pos; }
+    [[nodiscard]] bool operator==(const ArgIter& other) const { return m_pos == other.m_pos; }
+    [[nodiscard]] bool operator!=(const ArgIter& other) const { return m_pos != other.m_pos; }
+    [[nodiscard]] bool operator<(const ArgIter& other) const { return m_pos < other.m_pos; }
+  private:
+    const char* const* m_pos{nullptr};
+};
 
 BETTER_ENUM(ArgFlags, int, Required, Present)
+// the closed set of value kinds the concrete argument classes implement
+BETTER_ENUM(ArgKind, int, Switch, Int, String, StringChoice, File, Directory)
+// the argument classes whose values Parser::read handles without a virtual
+// call, see ArgBase::m_dispatch. Any other class goes through takes_value
+// and validate, also one derived from these.
+enum class ArgDispatch : std::uint8_t { Virtual, Switch, String, Int, Int64, UInt, Double };
+// what can be wrong with a command line, see Diagnostic
+BETTER_ENUM(DiagnosticKind, int, NotANumber, OutOfRange, DescendingRange, FloatRange, ListTooLong, InvalidChoice, PatternMismatch, MissingPath, NotAFile,
+            NotADirectory, UnreadablePath, InvalidValue, UnexpectedValue, MissingValue, UnexpectedArgument, UnknownFlag, UnknownCommand, MissingRequired,
+            MalformedConfig, UnreadableConfig, Conflict, MissingOneOf, MissingDependency)
+enum class DiagnosticSource : std::uint8_t { CommandLine, Environment, ConfigFile };
+
+// One problem of a command line, kept small such that a parse can list all of
+// them cheaply. Parser::describe formats the message.
+struct Diagnostic {
+  DiagnosticKind kind;
+  DiagnosticSource source;
+  // nullptr for tokens no argument takes
+  const ArgBase* arg;
+  // the offending token, empty if something is missing. For a broken
+  // group or dependency the other argument(s) of the rule.
+  std::string_view token;
+};
+
+// the diagnostic for a number check_number rejected
+[[nodiscard]] inline std::optional<DiagnosticKind> number_problem(std::errc ec) {
+  if (ec == std::errc{}) {
+    return std::nullopt;
+  }
+  return ec == std::errc::result_out_of_range ? +DiagnosticKind::OutOfRange : +DiagnosticKind::NotANumber;
+}
+
+// the diagnostic for a list check_number_list rejected
+[[nodiscard]] inline std::optional<DiagnosticKind> list_problem(ListError error, std::errc ec) {
+  switch (error) {
+    case ListError::None:
+      return std::nullopt;
+    case ListError::Number:
+      return number_problem(ec);
+    case ListError::FloatRange:
+      return +DiagnosticKind::FloatRange;
+    case ListError::Descending:
+      return +DiagnosticKind::DescendingRange;
+    case ListError::TooLarge:
+      return +DiagnosticKind::ListTooLong;
+  }
+  return std::nullopt;
+}
+
+// appends the diagnostics for the check_paths errors of the values first, ...
+// of arg
+inline void path_problems(const ArgBase& arg, PathKind kind, const std::string_view* first, const std::vector<int>& errors,
+                          DiagnosticSource source, std::pmr::vector<Diagnostic>& out) {
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i] == 0) {
+      continue;
+    }
+    auto problem = +DiagnosticKind::UnreadablePath;
+    if (errors[i] == path_wrong_kind) {
+      problem = kind == PathKind::Directory ? +DiagnosticKind::NotADirectory : +DiagnosticKind::NotAFile;
+    } else if (errors[i] == ENOENT) {
+      problem = +DiagnosticKind::MissingPath;
+    }
+    out.push_back({problem, source, &arg, first[i]});
+  }
+}
 
 class ArgBase {
   public:
     friend Parser;
+    friend ParseResult;
+    friend Constraints;
     virtual ~ArgBase() {}
   protected:
-    [[nodiscard]] virtual std::string completion_entry(bool skip_description) = 0;
-    virtual ArgIter parse(ArgIter) = 0;
+    // appends the zsh _arguments spec of this argument. Lists of more than
+    // helper_threshold values refer to a function of completion_helpers.
+    virtual void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const = 0;
+    // appends the zsh functions completion_entry refers to, if any
+    virtual void completion_helpers(fmt::memory_buffer& /*unused*/, std::size_t /*unused*/) const {}
+    // upper estimate of what completion_entry appends, to size output buffers
+    [[nodiscard]] virtual std::size_t completion_size() const {
+      return m_name.size() + m_doc.size() + m_shortdoc.size() + 8;
+    }
+    // the part of the spec all argument kinds share: name[doc]:shortdoc:
+    void completion_prefix(fmt::memory_buffer& out, bool skip_description, bool takes_value) const {
+      out.append(m_name.data(), m_name.data() + m_name.size());
+      if (!skip_description) {
+        fmt::format_to(std::back_inserter(out), "[{}]", m_doc);
+      }
+      if (takes_value) {
+        fmt::format_to(std::back_inserter(out), ":{}:", m_shortdoc);
+      }
+    }
+    // appends the answer to a dynamic completion request for a value of this
+    // argument starting with prefix, see Parser::render_candidates
+    virtual void candidates(fmt::memory_buffer& out, std::string_view /*unused*/) const {
+      fmt::format_to(std::back_inserter(out), "message {}\n", m_shortdoc);
+    }
+    // whether the argument consumes the token following its name
+    [[nodiscard]] virtual bool takes_value() const { return true; }
+    // throws std::invalid_argument if token is no valid value. Must not modify
+    // the argument, one Parser may parse on several threads at once.
+    virtual void check(std::string_view token) const = 0;
+    // check without exceptions, for Parser::try_parse: nothing if token is a
+    // valid value, what is wrong with it otherwise. The argument types of
+    // tabparse override it, the default catches what check throws.
+    [[nodiscard]] virtual std::optional<DiagnosticKind> validate(std::string_view token) const {
+      try {
+        check(token);
+      } catch (const std::invalid_argument&) {
+        return +DiagnosticKind::InvalidValue;
+      }
+      return std::nullopt;
+    }
+    // validate for a whole run of tokens, appends a diagnostic for each bad
+    // one to out, see check_all
+    virtual void validate_all(ArgIter first, ArgIter last, std::pmr::vector<Diagnostic>& out) const;
+    // the checks that look at all values of a parse at once (must_exist of
+    // paths), once they are stored: appends a diagnostic for each bad one of
+    // tokens to out, and the stats it took to infos
+    virtual void validate_stored(const TokenList& /*unused*/, DiagnosticSource /*unused*/, std::pmr::vector<Diagnostic>& /*unused*/,
+                                 std::vector<PathInfo>& /*unused*/) const {}
+    // after assign, takes over the stats validate_stored took in the same
+    // parse, see ParseResult::paths
+    virtual void take_stored(const std::vector<PathInfo>& /*unused*/) {}
+    // check for a whole run of tokens. The argument templates know their final
+    // type, their overrides resolve the conversion once per run instead of
+    // once per token and let the compiler inline it into the loop.
+    virtual void check_all(ArgIter first, ArgIter last) const {
+      for (; first != last; ++first) {
+        check(*first);
+      }
+    }
+    // takes over the tokens a parse found for this argument, for the
+    // Parser::parse overload that stores values in the arguments themselves
+    virtual void assign(const TokenList& tokens) = 0;
+    // called once when the Parser takes ownership, before the argument is
+    // handed out. Arguments that store more than one value allocate from it.
+    virtual void use_resource(std::pmr::memory_resource* /*unused*/) {}
     std::string m_name;
     std::string m_doc;
     std::string m_shortdoc;
+    // what the value falls back to if the argument is not on the command
+    // line, see Parser::config_file. Empty for none.
+    std::string m_env;
+    std::string m_config_key;
     EnumSet<ArgFlags> m_flags{0};
+    // position of this argument's values in a ParseResult
+    std::size_t m_slot{0};
+    // of the Parser that owns the argument, told about required()
+    Constraints* m_constraints{nullptr};
+    // set by the Parser for the exact classes of ArgDispatch, see dispatch_of
+    ArgDispatch m_dispatch{ArgDispatch::Virtual};
+    // the name in messages: the flag, or the shortdoc of a positional argument
+    [[nodiscard]] std::string_view label() const {
+      return m_name.front() == '-' ? std::string_view{m_name} : std::string_view{m_shortdoc};
+    }
+    void set_required(bool required);
   private:
 };
 
-class EndAwareArg {
-  public:
-    [[nodiscard]] virtual std::string completion_entry(bool skip_description) = 0;
-    virtual ArgIter parse(ArgIter, ArgIter) = 0;
-    virtual ~EndAwareArg() {}
-};
+// whether a token may stand for several values of a VectorArg<ARG>
+template <typename ARG, typename = void>
+struct has_list_syntax : std::false_type {};
+template <typename ARG>
+struct has_list_syntax<ARG, std::void_t<decltype(&ARG::convert_list)>> : std::true_type {};
+
+// whether ARG checks its values once they are all known, see PathValues
+template <typename ARG, typename = void>
+struct has_value_validation : std::false_type {};
+template <typename ARG>
+struct has_value_validation<ARG, std::void_t<decltype(&ARG::check_values)>> : std::true_type {};
 
 template <typename BASE_ARG>
-class MultiArg : public BASE_ARG, public EndAwareArg {
+class VectorArg : public BASE_ARG {
   public:
-    [[nodiscard]] ArgIter parse(ArgIter iter, ArgIter end) override {
-      for (; iter != end;) {
-        iter = BASE_ARG::parse(iter);
-        m_allvals.push_back(BASE_ARG::m_storage);
-      }
-      return iter;
-    }
     using BASE_ARG::BASE_ARG;
+    using vector_type = std::pmr::vector<typename BASE_ARG::type>;
     // removes TemplateArg::ref from the overload set
-    [[nodiscard]] std::vector<typename BASE_ARG::type>& ref() {
+    [[nodiscard]] vector_type& ref() {
       return m_allvals;
     }
-    [[nodiscard]] std::string completion_entry(bool skip_description) override {
-      return BASE_ARG::completion_entry(skip_description);
+    // removes TemplateArg::value_from from the overload set
+    [[nodiscard]] vector_type value_from(const TokenList& tokens) const {
+      vector_type retval;
+      retval.reserve(tokens.size());
+      append_values(tokens, retval);
+      return retval;
+    }
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const override {
+      out.push_back('*');
+      BASE_ARG::completion_entry(out, skip_description, helper_threshold);
+    }
+    [[nodiscard]] std::size_t completion_size() const override {
+      return BASE_ARG::completion_size() + 1;
     }
   protected:
-    std::vector<typename BASE_ARG::type> m_allvals;
+    void use_resource(std::pmr::memory_resource* resource) override {
+      // the allocator of a pmr container can not be replaced, only the
+      // (still empty) vector itself
+      m_allvals.~vector_type();
+      ::new (&m_allvals) vector_type{resource};
+    }
+    void assign(const TokenList& tokens) override {
+      if (tokens.empty()) {
+        return;
+      }
+      ArgBase::m_flags.set(ArgFlags::Present);
+      m_allvals.reserve(m_allvals.size() + tokens.size());
+      append_values(tokens, m_allvals);
+    }
+    void check(std::string_view token) const override {
+      if constexpr (has_list_syntax<BASE_ARG>::value) {
+        (void)this->convert_list(token, nullptr);
+      } else {
+        BASE_ARG::check(token);
+      }
+    }
+    void check_all(ArgIter first, ArgIter last) const override {
+      for (; first != last; ++first) {
+        // qualified, no virtual dispatch
+        VectorArg::check(*first);
+      }
+    }
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      if constexpr (has_list_syntax<BASE_ARG>::value) {
+        return this->validate_list(token);
+      } else {
+        return BASE_ARG::validate(token);
+      }
+    }
+    void validate_all(ArgIter first, ArgIter last, std::pmr::vector<Diagnostic>& out) const override {
+      for (; first != last; ++first) {
+        if (auto problem = VectorArg::validate(*first)) {
+          out.push_back({*problem, DiagnosticSource::CommandLine, this, *first});
+        }
+      }
+    }
+    void validate_stored(const TokenList& tokens, DiagnosticSource source, std::pmr::vector<Diagnostic>& out,
+                         std::vector<PathInfo>& infos) const override {
+      if constexpr (has_value_validation<BASE_ARG>::value) {
+        // all values, not only the last one as BASE_ARG
+        const auto* first = tokens.data();
+        path_problems(*this, this->m_kind, first, this->check_values(first, first + tokens.size(), infos), source, out);
+      }
+    }
+    void append_values(const TokenList& tokens, vector_type& into) const {
+      for (auto token : tokens) {
+        if constexpr (has_list_syntax<BASE_ARG>::value) {
+          this->convert_list(token, &into);
+        } else {
+          into.push_back(this->convert(token));
+        }
+      }
+    }
+    vector_type m_allvals;
 };
 
+// takes all remaining positional arguments, see Parser::addOther
 template <typename BASE_ARG>
-class VectorArg : public BASE_ARG {
+class MultiArg : public VectorArg<BASE_ARG> {
   public:
-    [[nodiscard]] ArgIter parse(ArgIter iter) override {
-      iter = BASE_ARG::parse(iter);
-      m_allvals.push_back(BASE_ARG::m_storage);
-      return iter;
-    }
-    using BASE_ARG::BASE_ARG;
-    // removes TemplateArg::ref from the overload set
-    [[nodiscard]] std::vector<typename BASE_ARG::type>& ref() {
-      return m_allvals;
+    using VectorArg<BASE_ARG>::VectorArg;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const override {
+      BASE_ARG::completion_entry(out, skip_description, helper_threshold);
     }
-    [[nodiscard]] std::string completion_entry(bool skip_description) override {
-      return fmt::format("*{}", BASE_ARG::completion_entry(skip_description));
+    [[nodiscard]] std::size_t completion_size() const override {
+      return BASE_ARG::completion_size();
     }
-  protected:
-    std::vector<typename BASE_ARG::type> m_allvals;
 };
 
 template <typename STORAGE_TYPE, typename FINAL_ARG>
@@ -91,95 +348,442 @@ class TemplateArg : public ArgBase {
       return m_storage;
     }
     FINAL_ARG* required(bool req) {
-      if (req) {
-        ArgBase::m_flags.set(ArgFlags::Required);
-      } else {
-        ArgBase::m_flags.reset(ArgFlags::Required);
-      }
-      return reinterpret_cast<FINAL_ARG*>(this);
+      ArgBase::set_required(req);
+      return static_cast<FINAL_ARG*>(this);
+    }
+    // takes the value of the environment variable if the argument is not on
+    // the command line
+    FINAL_ARG* env(std::string_view variable) {
+      ArgBase::m_env = variable;
+      return static_cast<FINAL_ARG*>(this);
+    }
+    // takes the value of key in the Parser's config file if the argument is
+    // neither on the command line nor in its environment variable
+    FINAL_ARG* config_key(std::string_view key) {
+      ArgBase::m_config_key = key;
+      return static_cast<FINAL_ARG*>(this);
+    }
+    // the value tokens stand for, the default if there are none (the last
+    // one wins if the argument was given repeatedly)
+    [[nodiscard]] type value_from(const TokenList& tokens) const {
+      return tokens.empty() ? m_storage : static_cast<const FINAL_ARG*>(this)->convert(tokens.back());
     }
     friend Parser;
   protected:
-    STORAGE_TYPE m_storage;
+    void check(std::string_view token) const override {
+      (void)static_cast<const FINAL_ARG*>(this)->convert(token);
+    }
+    void assign(const TokenList& tokens) override {
+      if (!tokens.empty()) {
+        ArgBase::m_flags.set(ArgFlags::Present);
+        m_storage = static_cast<const FINAL_ARG*>(this)->convert(tokens.back());
+      }
+    }
+    STORAGE_TYPE m_storage{};
 };
 
-template <typename FINAL_ARG>
-class StringArgBase : public TemplateArg<std::string, FINAL_ARG> {
+// STRING_TYPE may be std::string_view, in which case the stored value refers
+// directly into argv (or whatever else the ArgIter walks) and nothing is copied.
+template <typename FINAL_ARG, typename STRING_TYPE = std::string>
+class StringArgBase : public TemplateArg<STRING_TYPE, FINAL_ARG> {
   public:
-    using TemplateArg<std::string, FINAL_ARG>::TemplateArg;
+    using TemplateArg<STRING_TYPE, FINAL_ARG>::TemplateArg;
     virtual ~StringArgBase() {}
+    [[nodiscard]] STRING_TYPE convert(std::string_view token) const {
+      return STRING_TYPE{token};
+    }
   protected:
-    [[nodiscard]] ArgIter parse(ArgIter iter) override;
+    // any string is fine, no need to build one to find out
+    void check(std::string_view /*unused*/) const override {}
 };
 
-class StringArg : public StringArgBase<StringArg> {
+template <typename STRING_TYPE>
+class BasicStringArg : public StringArgBase<BasicStringArg<STRING_TYPE>, STRING_TYPE> {
   public:
-    using StringArgBase::StringArgBase;
-    virtual ~StringArg() {}
+    using StringArgBase<BasicStringArg<STRING_TYPE>, STRING_TYPE>::StringArgBase;
+    virtual ~BasicStringArg() {}
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override;
 };
 
-class StringChoiceArg : public StringArgBase<StringChoiceArg> {
+template <typename STRING_TYPE>
+class BasicStringChoiceArg : public StringArgBase<BasicStringChoiceArg<STRING_TYPE>, STRING_TYPE> {
   public:
-    StringChoiceArg(std::string_view name, std::string_view default_value,
+    BasicStringChoiceArg(std::string_view name, std::string_view default_value,
                     std::string_view shortdoc, std::string_view doc,
-                    std::initializer_list<std::string> options,
-                    std::initializer_list<std::string> descriptions = {})
+                    std::vector<std::string> options,
+                    std::vector<std::string> descriptions = {})
         : m_choices{std::move(options)}, m_descriptions{std::move(descriptions)} {
       ArgBase::m_name = name;
       ArgBase::m_shortdoc = shortdoc;
       ArgBase::m_doc = doc;
-      TemplateArg<std::string, StringChoiceArg>::m_storage = default_value;
+      TemplateArg<STRING_TYPE, BasicStringChoiceArg>::m_storage = default_value;
       if (m_choices.size() != m_descriptions.size() && !m_descriptions.empty()) {
         throw std::length_error("if descriptions are provided, then one must be provided for each option");
       }
+      m_sorted.resize(m_choices.size());
+      for (std::size_t i = 0; i < m_sorted.size(); ++i) {
+        m_sorted[i] = i;
+      }
+      std::sort(m_sorted.begin(), m_sorted.end(), [this](std::size_t a, std::size_t b) { return m_choices[a] < m_choices[b]; });
     }
-    virtual ~StringChoiceArg() {}
+    virtual ~BasicStringChoiceArg() {}
+    // position of token among the choices, throws std::invalid_argument if it
+    // is none of them
+    [[nodiscard]] std::size_t index_of(std::string_view token) const;
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const override;
+    void completion_helpers(fmt::memory_buffer& out, std::size_t helper_threshold) const override;
+    [[nodiscard]] std::size_t completion_size() const override;
+    void candidates(fmt::memory_buffer& out, std::string_view prefix) const override;
     std::vector<std::string> m_choices;
     std::vector<std::string> m_descriptions;
-    [[nodiscard]] ArgIter parse(ArgIter iter) override ;
+    // indices into m_choices in the order of their strings, for binary search
+    std::vector<std::size_t> m_sorted;
+    // index_of, m_choices.size() for tokens that are no choice
+    [[nodiscard]] std::size_t position(std::string_view token) const;
+    void check(std::string_view token) const override;
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      return position(token) == m_choices.size() ? std::optional{+DiagnosticKind::InvalidChoice} : std::nullopt;
+    }
+  public:
+    [[nodiscard]] STRING_TYPE convert(std::string_view token) const;
+};
+
+// a choice among values only known at runtime, see ChoiceCache. The completion
+// file asks the program for them at TAB time, which answers from the cache
+// under $XDG_CACHE_HOME/tabparse/cache_key for ttl before it asks provider
+// again. Parsing checks against the same list.
+template <typename STRING_TYPE>
+class BasicDynamicChoiceArg : public StringArgBase<BasicDynamicChoiceArg<STRING_TYPE>, STRING_TYPE> {
+  public:
+    BasicDynamicChoiceArg(std::string_view name, std::string_view default_value,
+                          std::string_view shortdoc, std::string_view doc,
+                          std::string_view cache_key, ChoiceProvider provider,
+                          std::chrono::seconds ttl = std::chrono::hours{1})
+        : m_cache{cache_key, std::move(provider), ttl} {
+      ArgBase::m_name = name;
+      ArgBase::m_shortdoc = shortdoc;
+      ArgBase::m_doc = doc;
+      TemplateArg<STRING_TYPE, BasicDynamicChoiceArg>::m_storage = default_value;
+    }
+    virtual ~BasicDynamicChoiceArg() {}
+    [[nodiscard]] const ChoiceList& choices() const { return m_cache.get(); }
+    // for when the values are known to have changed before the ttl is over
+    void invalidate() { m_cache.invalidate(); }
+    [[nodiscard]] STRING_TYPE convert(std::string_view token) const {
+      check(token);
+      return STRING_TYPE{token};
+    }
+  protected:
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override {
+      this->completion_prefix(out, skip_description, true);
+      out.append(query_function_name.data(), query_function_name.data() + query_function_name.size());
+    }
+    void completion_helpers(fmt::memory_buffer& out, std::size_t /*unused*/) const override {
+      append_query_function(out);
+    }
+    [[nodiscard]] std::size_t completion_size() const override {
+      return ArgBase::completion_size() + query_function_name.size();
+    }
+    void candidates(fmt::memory_buffer& out, std::string_view prefix) const override {
+      const auto& list = m_cache.get();
+      fmt::format_to(std::back_inserter(out), "describe {}\n", this->m_shortdoc);
+      for (std::size_t i = 0; i < list.values.size(); ++i) {
+        if (std::string_view{list.values[i]}.substr(0, prefix.size()) == prefix) {
+          append_candidate(out, list.values[i], list.descriptions.empty() ? std::string_view{} : list.descriptions[i]);
+        }
+      }
+    }
+    void check(std::string_view token) const override {
+      if (!m_cache.contains(token)) {
+        throw std::invalid_argument(fmt::format("{} is not a valid choice for {}.", token, this->m_name));
+      }
+    }
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      return m_cache.contains(token) ? std::nullopt : std::optional{+DiagnosticKind::InvalidChoice};
+    }
+    ChoiceCache m_cache;
+};
+
+// the names of a BETTER_ENUM, sorted for lookup by binary search. Built once
+// per enum type.
+template <typename ENUM>
+struct EnumNames {
+  [[nodiscard]] static const std::vector<std::string>& names() {
+    static const std::vector<std::string> retval = [] {
+      std::vector<std::string> list;
+      list.reserve(ENUM::_size());
+      for (const char* name : ENUM::_names()) {
+        list.emplace_back(name);
+      }
+      return list;
+    }();
+    return retval;
+  }
+  // position of token in ENUM::_names(), ENUM::_size() if it is none of them
+  [[nodiscard]] static std::size_t index_of(std::string_view token) {
+    using entry = std::pair<std::string_view, std::size_t>;
+    static const std::vector<entry> sorted = [] {
+      std::vector<entry> table;
+      table.reserve(ENUM::_size());
+      for (std::size_t i = 0; i < names().size(); ++i) {
+        table.emplace_back(names()[i], i);
+      }
+      std::sort(table.begin(), table.end());
+      return table;
+    }();
+    auto found = std::lower_bound(sorted.begin(), sorted.end(), entry{token, 0});
+    return found != sorted.end() && found->first == token ? found->second : ENUM::_size();
+  }
+};
+
+// what EnumChoiceArg and EnumSetArg share: validation against the names of
+// ENUM and their completion, optionally with one description per enumerator
+template <typename ENUM, typename STORAGE_TYPE, typename FINAL_ARG>
+class EnumArgBase : public TemplateArg<STORAGE_TYPE, FINAL_ARG> {
+  public:
+    EnumArgBase(std::string_view name, STORAGE_TYPE default_value, std::string_view shortdoc, std::string_view doc,
+                std::vector<std::string> descriptions = {})
+        : TemplateArg<STORAGE_TYPE, FINAL_ARG>{name, default_value, shortdoc, doc}, m_descriptions{std::move(descriptions)} {
+      if (!m_descriptions.empty() && m_descriptions.size() != ENUM::_size()) {
+        throw std::length_error("if descriptions are provided, then one must be provided for each enumerator");
+      }
+    }
+    // the enumerator named token, throws std::invalid_argument for other tokens
+    [[nodiscard]] ENUM enum_value(std::string_view token) const {
+      std::size_t index = EnumNames<ENUM>::index_of(token);
+      if (index == ENUM::_size()) {
+        throw std::invalid_argument(fmt::format("{} is not a valid choice for {}.", token, this->m_name));
+      }
+      return ENUM::_values()[index];
+    }
+  protected:
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const override {
+      this->completion_prefix(out, skip_description, true);
+      append_choice_action(out, this->m_shortdoc, EnumNames<ENUM>::names(), m_descriptions, helper_threshold);
+    }
+    void completion_helpers(fmt::memory_buffer& out, std::size_t helper_threshold) const override {
+      if (ENUM::_size() > helper_threshold) {
+        append_choice_function(out, this->m_shortdoc, EnumNames<ENUM>::names(), m_descriptions);
+      }
+    }
+    [[nodiscard]] std::size_t completion_size() const override {
+      std::size_t retval = ArgBase::completion_size() + 4;
+      for (const auto& name : EnumNames<ENUM>::names()) {
+        retval += name.size() + 1;
+      }
+      for (const auto& description : m_descriptions) {
+        retval += description.size() + 4;
+      }
+      return retval;
+    }
+    void candidates(fmt::memory_buffer& out, std::string_view prefix) const override {
+      const auto& names = EnumNames<ENUM>::names();
+      fmt::format_to(std::back_inserter(out), "describe {}\n", this->m_shortdoc);
+      for (std::size_t i = 0; i < names.size(); ++i) {
+        if (std::string_view{names[i]}.substr(0, prefix.size()) == prefix) {
+          append_candidate(out, names[i], m_descriptions.empty() ? std::string_view{} : m_descriptions[i]);
+        }
+      }
+    }
+    void check(std::string_view token) const override {
+      (void)enum_value(token);
+    }
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      return EnumNames<ENUM>::index_of(token) == ENUM::_size() ? std::optional{+DiagnosticKind::InvalidChoice} : std::nullopt;
+    }
+    std::vector<std::string> m_descriptions;
+};
+
+// a choice among the names of a BETTER_ENUM. The value is the enumerator, the
+// program can switch on it instead of comparing strings again. As VectorArg
+// the values are an array of enumerators, each of the size of the enum's
+// underlying integer.
+template <typename ENUM>
+class EnumChoiceArg : public EnumArgBase<ENUM, ENUM, EnumChoiceArg<ENUM>> {
+  public:
+    using EnumArgBase<ENUM, ENUM, EnumChoiceArg<ENUM>>::EnumArgBase;
+    virtual ~EnumChoiceArg() {}
+    [[nodiscard]] ENUM convert(std::string_view token) const {
+      return this->enum_value(token);
+    }
 };
 
-class FileArg : public StringArgBase<FileArg> {
+// like VectorArg<EnumChoiceArg<ENUM>>, but collects the enumerators given in
+// an EnumSet, which repeating one does not change
+template <typename ENUM>
+class EnumSetArg : public EnumArgBase<ENUM, EnumSet<ENUM>, EnumSetArg<ENUM>> {
   public:
-    FileArg(std::string_view name, std::string_view default_value,
+    using EnumArgBase<ENUM, EnumSet<ENUM>, EnumSetArg<ENUM>>::EnumArgBase;
+    virtual ~EnumSetArg() {}
+    [[nodiscard]] EnumSet<ENUM> convert(std::string_view token) const {
+      EnumSet<ENUM> retval;
+      retval.set(std::size_t(this->enum_value(token)._to_integral()));
+      return retval;
+    }
+    // removes TemplateArg::value_from from the overload set, all tokens count
+    [[nodiscard]] EnumSet<ENUM> value_from(const TokenList& tokens) const {
+      if (tokens.empty()) {
+        return this->m_storage;
+      }
+      EnumSet<ENUM> retval;
+      for (auto token : tokens) {
+        retval |= convert(token);
+      }
+      return retval;
+    }
+  protected:
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const override {
+      out.push_back('*');
+      EnumArgBase<ENUM, EnumSet<ENUM>, EnumSetArg<ENUM>>::completion_entry(out, skip_description, helper_threshold);
+    }
+    [[nodiscard]] std::size_t completion_size() const override {
+      return EnumArgBase<ENUM, EnumSet<ENUM>, EnumSetArg<ENUM>>::completion_size() + 1;
+    }
+    void assign(const TokenList& tokens) override {
+      if (!tokens.empty()) {
+        ArgBase::m_flags.set(ArgFlags::Present);
+        this->m_storage = value_from(tokens);
+      }
+    }
+};
+
+template <typename STRING_TYPE>
+class BasicFileArg : public StringArgBase<BasicFileArg<STRING_TYPE>, STRING_TYPE>, public PathValues {
+  public:
+    BasicFileArg(std::string_view name, std::string_view default_value,
         std::string_view shortdoc, std::string_view doc,
         std::string_view pattern)
-        : m_pattern{std::move(pattern)} {
+        : PathValues{PathKind::File}, m_pattern{std::move(pattern)} {
       ArgBase::m_name = name;
       ArgBase::m_shortdoc = shortdoc;
       ArgBase::m_doc = doc;
-      TemplateArg<std::string, FileArg>::m_storage = default_value;
+      TemplateArg<STRING_TYPE, BasicFileArg>::m_storage = default_value;
+    }
+    virtual ~BasicFileArg() {}
+    // values have to match the pattern, not only completion offers such
+    BasicFileArg* must_match(bool match) {
+      if (match) {
+        m_glob = GlobPattern{m_pattern};
+      }
+      m_must_match = match;
+      return this;
+    }
+    // values have to exist and not be directories, see PathValues::info
+    BasicFileArg* must_exist(bool exist) {
+      m_must_exist = exist;
+      return this;
     }
-    virtual ~FileArg() {}
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override;
+    [[nodiscard]] std::size_t completion_size() const override {
+      return ArgBase::completion_size() + m_pattern.size() + 16;
+    }
+    void candidates(fmt::memory_buffer& out, std::string_view /*unused*/) const override {
+      fmt::format_to(std::back_inserter(out), "files {}\n", m_pattern);
+    }
+    void check(std::string_view token) const override {
+      if (m_must_match && !m_glob.matches(token)) {
+        throw std::invalid_argument(fmt::format("{} does not match {}.", token, m_pattern));
+      }
+    }
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      return m_must_match && !m_glob.matches(token) ? std::optional{+DiagnosticKind::PatternMismatch} : std::nullopt;
+    }
+    void validate_stored(const TokenList& tokens, DiagnosticSource source, std::pmr::vector<Diagnostic>& out,
+                         std::vector<PathInfo>& infos) const override {
+      // only the last value is kept
+      if (!tokens.empty()) {
+        path_problems(*this, m_kind, &tokens.back(), check_values(&tokens.back(), &tokens.back() + 1, infos), source, out);
+      }
+    }
+    void take_stored(const std::vector<PathInfo>& infos) override { m_info = infos; }
     std::string m_pattern;
+    GlobPattern m_glob;
+    bool m_must_match{false};
 };
 
-class DirectoryArg : public StringArgBase<DirectoryArg> {
+template <typename STRING_TYPE>
+class BasicDirectoryArg : public StringArgBase<BasicDirectoryArg<STRING_TYPE>, STRING_TYPE>, public PathValues {
   public:
-    using StringArgBase::StringArgBase;
-    virtual ~DirectoryArg() {}
+    BasicDirectoryArg(std::string_view name, std::string_view default_value, std::string_view shortdoc, std::string_view doc)
+        : StringArgBase<BasicDirectoryArg<STRING_TYPE>, STRING_TYPE>{name, STRING_TYPE{default_value}, shortdoc, doc},
+          PathValues{PathKind::Directory} {}
+    virtual ~BasicDirectoryArg() {}
+    // values have to be existing directories, see PathValues::info
+    BasicDirectoryArg* must_exist(bool exist) {
+      m_must_exist = exist;
+      return this;
+    }
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override;
+    void candidates(fmt::memory_buffer& out, std::string_view /*unused*/) const override {
+      fmt::format_to(std::back_inserter(out), "directories\n");
+    }
+    void validate_stored(const TokenList& tokens, DiagnosticSource source, std::pmr::vector<Diagnostic>& out,
+                         std::vector<PathInfo>& infos) const override {
+      // only the last value is kept
+      if (!tokens.empty()) {
+        path_problems(*this, m_kind, &tokens.back(), check_values(&tokens.back(), &tokens.back() + 1, infos), source, out);
+      }
+    }
+    void take_stored(const std::vector<PathInfo>& infos) override { m_info = infos; }
 };
 
-class IntArg : public TemplateArg<int, IntArg> {
+using StringArg = BasicStringArg<std::string>;
+using StringChoiceArg = BasicStringChoiceArg<std::string>;
+using FileArg = BasicFileArg<std::string>;
+using DirectoryArg = BasicDirectoryArg<std::string>;
+using DynamicChoiceArg = BasicDynamicChoiceArg<std::string>;
+
+using StringViewArg = BasicStringArg<std::string_view>;
+using StringChoiceViewArg = BasicStringChoiceArg<std::string_view>;
+using FileViewArg = BasicFileArg<std::string_view>;
+using DirectoryViewArg = BasicDirectoryArg<std::string_view>;
+using DynamicChoiceViewArg = BasicDynamicChoiceArg<std::string_view>;
+
+// IntArg, Int64Arg, UIntArg and DoubleArg. As VectorArg or MultiArg, every
+// token may hold a whole list of values, see parse_number_list.
+template <typename NUMBER>
+class NumericArg : public TemplateArg<NUMBER, NumericArg<NUMBER>> {
   public:
-    using TemplateArg<int, IntArg>::TemplateArg;
-    virtual ~IntArg() {}
+    using TemplateArg<NUMBER, NumericArg<NUMBER>>::TemplateArg;
+    virtual ~NumericArg() {}
+    [[nodiscard]] NUMBER convert(std::string_view token) const {
+      return parse_number<NUMBER>(token);
+    }
+    // appends the values of a list token to out (if given), returns their number
+    std::size_t convert_list(std::string_view token, std::pmr::vector<NUMBER>* out) const {
+      return parse_number_list<NUMBER>(token, out);
+    }
+    // validate for a list token
+    [[nodiscard]] std::optional<DiagnosticKind> validate_list(std::string_view token) const {
+      std::errc ec{};
+      auto error = check_number_list<NUMBER>(token, ec);
+      return list_problem(error, ec);
+    }
+    // validate without an object, for the closed-set dispatch of Parser
+    [[nodiscard]] static std::optional<DiagnosticKind> validate_number(std::string_view token) {
+      return number_problem(check_number<NUMBER>(token));
+    }
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
-    [[nodiscard]] ArgIter parse(ArgIter) override;
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override {
+      this->completion_prefix(out, skip_description, true);
+    }
+    [[nodiscard]] std::optional<DiagnosticKind> validate(std::string_view token) const override {
+      return validate_number(token);
+    }
 };
 
+using IntArg = NumericArg<int>;
+using Int64Arg = NumericArg<std::int64_t>;
+using UIntArg = NumericArg<std::uint64_t>;
+using DoubleArg = NumericArg<double>;
+
 // class BoolArg : public TemplateArg<bool> {
-//   protected:
-//     ArgIter parse(ArgIter) override;
+//   public:
+//     bool convert(std::string_view) const;
 // };
 
 class SwitchArg : public TemplateArg<bool, SwitchArg> {
@@ -196,8 +800,114 @@ class SwitchArg : public TemplateArg<bool, SwitchArg> {
     }
     virtual ~SwitchArg() {}
     friend Parser;
+    // the token is the flag itself
+    [[nodiscard]] bool convert(std::string_view /*unused*/) const { return true; }
   protected:
-    [[nodiscard]] std::string completion_entry(bool skip_description) override;
-    [[nodiscard]] ArgIter parse(ArgIter) override;
-    bool m_storage{false};
+    void completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const override;
+    [[nodiscard]] bool takes_value() const override { return false; }
 };
+
+// the ArgDispatch of an argument of class ARG
+template <typename ARG>
+constexpr ArgDispatch dispatch_of() {
+  if constexpr (std::is_same_v<ARG, SwitchArg>) {
+    return ArgDispatch::Switch;
+  } else if constexpr (std::is_same_v<ARG, BasicStringArg<std::string>> || std::is_same_v<ARG, BasicStringArg<std::string_view>>) {
+    return ArgDispatch::String;
+  } else if constexpr (std::is_same_v<ARG, IntArg>) {
+    return ArgDispatch::Int;
+  } else if constexpr (std::is_same_v<ARG, Int64Arg>) {
+    return ArgDispatch::Int64;
+  } else if constexpr (std::is_same_v<ARG, UIntArg>) {
+    return ArgDispatch::UInt;
+  } else if constexpr (std::is_same_v<ARG, DoubleArg>) {
+    return ArgDispatch::Double;
+  } else {
+    return ArgDispatch::Virtual;
+  }
+}
+
+template <typename STRING_TYPE>
+void BasicFileArg<STRING_TYPE>::completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const {
+  this->completion_prefix(out, skip_description, true);
+  fmt::format_to(std::back_inserter(out), " _files -g '{}'", m_pattern);
+}
+
+template <typename STRING_TYPE>
+void BasicDirectoryArg<STRING_TYPE>::completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const {
+  this->completion_prefix(out, skip_description, true);
+  fmt::format_to(std::back_inserter(out), " _files -/");
+}
+
+template <typename STRING_TYPE>
+void BasicStringArg<STRING_TYPE>::completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const {
+  this->completion_prefix(out, skip_description, true);
+}
+
+template <typename STRING_TYPE>
+void BasicStringChoiceArg<STRING_TYPE>::completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t helper_threshold) const {
+  this->completion_prefix(out, skip_description, true);
+  append_choice_action(out, this->m_shortdoc, m_choices, m_descriptions, helper_threshold);
+}
+
+template <typename STRING_TYPE>
+void BasicStringChoiceArg<STRING_TYPE>::completion_helpers(fmt::memory_buffer& out, std::size_t helper_threshold) const {
+  if (m_choices.size() > helper_threshold) {
+    append_choice_function(out, this->m_shortdoc, m_choices, m_descriptions);
+  }
+}
+
+template <typename STRING_TYPE>
+std::size_t BasicStringChoiceArg<STRING_TYPE>::completion_size() const {
+  std::size_t retval = ArgBase::completion_size() + 4;
+  for (const auto& choice : m_choices) {
+    retval += choice.size() + 1;
+  }
+  for (const auto& description : m_descriptions) {
+    retval += description.size() + 4;
+  }
+  return retval;
+}
+
+template <typename STRING_TYPE>
+void BasicStringChoiceArg<STRING_TYPE>::candidates(fmt::memory_buffer& out, std::string_view prefix) const {
+  fmt::format_to(std::back_inserter(out), "describe {}\n", this->m_shortdoc);
+  for (std::size_t i = 0; i < m_choices.size(); ++i) {
+    if (std::string_view{m_choices[i]}.substr(0, prefix.size()) == prefix) {
+      append_candidate(out, m_choices[i], m_descriptions.empty() ? std::string_view{} : m_descriptions[i]);
+    }
+  }
+}
+
+template <typename STRING_TYPE>
+std::size_t BasicStringChoiceArg<STRING_TYPE>::position(std::string_view token) const {
+  auto found = std::lower_bound(m_sorted.begin(), m_sorted.end(), token,
+                                [this](std::size_t i, std::string_view value) { return m_choices[i] < value; });
+  return found == m_sorted.end() || m_choices[*found] != token ? m_choices.size() : *found;
+}
+
+template <typename STRING_TYPE>
+std::size_t BasicStringChoiceArg<STRING_TYPE>::index_of(std::string_view token) const {
+  std::size_t index = position(token);
+  if (index == m_choices.size()) {
+    throw std::invalid_argument(fmt::format("{} is not a valid choice for {}.", token, this->m_name));
+  }
+  return index;
+}
+
+template <typename STRING_TYPE>
+void BasicStringChoiceArg<STRING_TYPE>::check(std::string_view token) const {
+  (void)index_of(token);
+}
+
+template <typename STRING_TYPE>
+STRING_TYPE BasicStringChoiceArg<STRING_TYPE>::convert(std::string_view token) const {
+  check(token);
+  return STRING_TYPE{token};
+}
+
+#ifdef TABPARSE_HEADER_ONLY
+#include "v_opt.cpp"
+// defines ArgBase::set_required
+#include "constraints.h"
+#endif
@@ -0,0 +1,109 @@
+#include "batch.h"
+#include "header_only.h"
+#include <algorithm>
+#include <exception>
+#include <utility>
+
+namespace batch_detail {
+// command lines a worker claims at once, to keep the shared counter cool
+inline constexpr std::size_t chunk_size = 64;
+}
+
+TABPARSE_INLINE BatchParser::BatchParser(const Parser& parser, unsigned n_threads) : m_parser{parser} {
+  // with a single thread the calling thread does all the work
+  if (n_threads > 1) {
+    m_threads.reserve(n_threads);
+    for (unsigned i = 0; i < n_threads; ++i) {
+      m_threads.emplace_back([this] { work(); });
+    }
+  }
+}
+
+TABPARSE_INLINE BatchParser::~BatchParser() {
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_stop = true;
+  }
+  m_start.notify_all();
+  for (auto& thread : m_threads) {
+    thread.join();
+  }
+}
+
+TABPARSE_INLINE void BatchParser::parse(const std::vector<CommandLine>& commands, std::vector<ParseResult>& results) {
+  results.resize(commands.size());
+  {
+    std::lock_guard<std::mutex> lock{m_mutex};
+    m_commands = &commands;
+    m_results = &results;
+    m_next = 0;
+    m_busy = m_threads.size();
+    ++m_generation;
+  }
+  if (m_threads.empty()) {
+    parse_range();
+    return;
+  }
+  m_start.notify_all();
+  std::unique_lock<std::mutex> lock{m_mutex};
+  m_done.wait(lock, [this] { return m_busy == 0; });
+  if (m_failure) {
+    std::rethrow_exception(std::exchange(m_failure, nullptr));
+  }
+}
+
+TABPARSE_INLINE void BatchParser::parse_range() {
+  const auto& commands = *m_commands;
+  auto& results = *m_results;
+  for (;;) {
+    std::size_t first = m_next.fetch_add(batch_detail::chunk_size, std::memory_order_relaxed);
+    if (first >= commands.size()) {
+      return;
+    }
+    std::size_t last = std::min(first + batch_detail::chunk_size, commands.size());
+    for (std::size_t i = first; i < last; ++i) {
+      const auto& command = commands[i];
+      results[i].m_error.clear();
+      // bad command lines are common in a batch, no unwinding for them. What
+      // still throws (a config file, a choice provider, the allocator) only
+      // fails its own command line.
+      try {
+        if (!m_parser.try_parse(command.argc, command.argv, results[i])) {
+          results[i].m_error = m_parser.describe(results[i].diagnostics().front());
+        }
+      } catch (const std::exception& e) {
+        results[i].m_error = e.what();
+      } catch (...) {
+        results[i].m_error = "unknown exception while parsing.";
+      }
+    }
+  }
+}
+
+TABPARSE_INLINE void BatchParser::work() {
+  std::size_t seen = 0;
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock{m_mutex};
+      m_start.wait(lock, [this, seen] { return m_stop || m_generation != seen; });
+      if (m_stop) {
+        return;
+      }
+      seen = m_generation;
+    }
+    std::exception_ptr failure;
+    try {
+      parse_range();
+    } catch (...) {
+      // storing the message failed as well, parse rethrows it
+      failure = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock{m_mutex};
+    if (failure && !m_failure) {
+      m_failure = failure;
+    }
+    if (--m_busy == 0) {
+      m_done.notify_all();
+    }
+  }
+}
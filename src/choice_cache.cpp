@@ -0,0 +1,156 @@
+#include "choice_cache.h"
+#include "header_only.h"
+#include "output.h"
+#include <cerrno>
+#include <cstdlib>
+#include <ctime>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace choice_cache_detail {
+// first line of a cache file, a new layout gets a new number
+constexpr std::string_view header = "tabparse-choices 1\n";
+
+TABPARSE_INLINE std::string read_file(int fd, std::size_t size) {
+  std::string content(size, '\0');
+  std::size_t done = 0;
+  while (done < size) {
+    auto n = ::read(fd, content.data() + done, size - done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    done += std::size_t(n);
+  }
+  content.resize(done);
+  return content;
+}
+
+// mkdir -p of the directory part of path
+TABPARSE_INLINE void create_parents(const std::string& path) {
+  for (auto slash = path.find('/', 1); slash != std::string::npos; slash = path.find('/', slash + 1)) {
+    ::mkdir(path.substr(0, slash).c_str(), 0700);
+  }
+}
+}
+
+TABPARSE_INLINE std::string choice_cache_path(std::string_view key) {
+  if (key.empty() || key.find('/') != std::string_view::npos) {
+    throw std::invalid_argument(fmt::format("choice cache key {} must be a nonempty file name.", key));
+  }
+  const char* xdg = std::getenv("XDG_CACHE_HOME");
+  if (xdg && *xdg == '/') {
+    return fmt::format("{}/tabparse/{}", xdg, key);
+  }
+  const char* home = std::getenv("HOME");
+  return fmt::format("{}/.cache/tabparse/{}", home ? home : "/tmp", key);
+}
+
+TABPARSE_INLINE std::optional<ChoiceList> read_choice_cache(const std::string& path, std::chrono::seconds ttl) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat st{};
+  bool fresh = ::fstat(fd, &st) == 0 && std::time(nullptr) - st.st_mtime < ttl.count();
+  std::string content = fresh ? choice_cache_detail::read_file(fd, std::size_t(st.st_size)) : std::string{};
+  ::close(fd);
+  std::string_view rest{content};
+  if (!fresh || rest.substr(0, choice_cache_detail::header.size()) != choice_cache_detail::header) {
+    return std::nullopt;
+  }
+  rest.remove_prefix(choice_cache_detail::header.size());
+  // value NUL description NUL, for every value
+  ChoiceList list;
+  bool described = false;
+  while (!rest.empty()) {
+    auto value_end = rest.find('\0');
+    auto description_end = value_end == std::string_view::npos ? value_end : rest.find('\0', value_end + 1);
+    if (description_end == std::string_view::npos) {
+      // truncated, as good as none
+      return std::nullopt;
+    }
+    list.values.emplace_back(rest.substr(0, value_end));
+    list.descriptions.emplace_back(rest.substr(value_end + 1, description_end - value_end - 1));
+    described = described || !list.descriptions.back().empty();
+    rest.remove_prefix(description_end + 1);
+  }
+  if (!described) {
+    list.descriptions.clear();
+  }
+  return list;
+}
+
+TABPARSE_INLINE void write_choice_cache(const std::string& path, const ChoiceList& list) {
+  fmt::memory_buffer out;
+  out.append(choice_cache_detail::header.data(), choice_cache_detail::header.data() + choice_cache_detail::header.size());
+  for (std::size_t i = 0; i < list.values.size(); ++i) {
+    const auto& value = list.values[i];
+    out.append(value.data(), value.data() + value.size());
+    out.push_back('\0');
+    if (!list.descriptions.empty()) {
+      const auto& description = list.descriptions[i];
+      out.append(description.data(), description.data() + description.size());
+    }
+    out.push_back('\0');
+  }
+  choice_cache_detail::create_parents(path);
+  // readers see the old file or the new one, never a partial one
+  auto tmp = fmt::format("{}.{}", path, ::getpid());
+  try {
+    write_buffer(tmp, {out.data(), out.size()});
+  } catch (const std::system_error&) {
+    ::unlink(tmp.c_str());
+    return;
+  }
+  if (::rename(tmp.c_str(), path.c_str()) != 0) {
+    ::unlink(tmp.c_str());
+  }
+}
+
+TABPARSE_INLINE const ChoiceList& ChoiceCache::get() const {
+  if (!m_loaded.load(std::memory_order_acquire)) {
+    load();
+  }
+  return m_list;
+}
+
+TABPARSE_INLINE bool ChoiceCache::contains(std::string_view value) const {
+  (void)get();
+  return m_index.count(value) != 0;
+}
+
+TABPARSE_INLINE void ChoiceCache::load() const {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  if (m_loaded.load(std::memory_order_relaxed)) {
+    return;
+  }
+  if (auto cached = read_choice_cache(m_path, m_ttl)) {
+    m_list = std::move(*cached);
+  } else {
+    m_list = m_provider();
+    if (!m_list.descriptions.empty() && m_list.descriptions.size() != m_list.values.size()) {
+      throw std::length_error("if descriptions are provided, then one must be provided for each option");
+    }
+    write_choice_cache(m_path, m_list);
+  }
+  m_index.clear();
+  m_index.reserve(m_list.values.size());
+  for (const auto& value : m_list.values) {
+    m_index.insert(value);
+  }
+  m_loaded.store(true, std::memory_order_release);
+}
+
+TABPARSE_INLINE void ChoiceCache::invalidate() {
+  std::lock_guard<std::mutex> lock{m_mutex};
+  ::unlink(m_path.c_str());
+  m_index.clear();
+  m_list = ChoiceList{};
+  m_loaded.store(false, std::memory_order_release);
+}
@@ -0,0 +1,99 @@
+#include "config_file.h"
+#include "header_only.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace config_file_detail {
+TABPARSE_INLINE std::string_view trim(std::string_view text) {
+  constexpr std::string_view blank = " \t\r";
+  auto first = text.find_first_not_of(blank);
+  if (first == std::string_view::npos) {
+    return {};
+  }
+  return text.substr(first, text.find_last_not_of(blank) - first + 1);
+}
+}
+
+TABPARSE_INLINE ConfigFile::ConfigFile(std::string path) : m_path{std::move(path)} {
+  int fd = ::open(m_path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    if (errno != ENOENT) {
+      m_error = std::generic_category().message(errno);
+    }
+    return;
+  }
+  struct stat st{};
+  if (::fstat(fd, &st) != 0) {
+    m_error = std::generic_category().message(errno);
+  } else if (S_ISDIR(st.st_mode)) {
+    m_error = std::generic_category().message(EISDIR);
+  } else if (st.st_size > 0) {
+    void* area = ::mmap(nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    if (area == MAP_FAILED) {
+      m_error = std::generic_category().message(errno);
+    } else {
+      m_data = static_cast<const char*>(area);
+      m_size = std::size_t(st.st_size);
+    }
+  }
+  ::close(fd);
+}
+
+TABPARSE_INLINE ConfigFile::ConfigFile(ConfigFile&& other) noexcept
+    : m_path{std::move(other.m_path)}, m_data{std::exchange(other.m_data, nullptr)}, m_size{std::exchange(other.m_size, 0)},
+      m_scanned{other.m_scanned}, m_error{std::move(other.m_error)}, m_malformed{other.m_malformed}, m_index{std::move(other.m_index)} {}
+
+TABPARSE_INLINE ConfigFile& ConfigFile::operator=(ConfigFile&& other) noexcept {
+  std::swap(m_path, other.m_path);
+  std::swap(m_data, other.m_data);
+  std::swap(m_size, other.m_size);
+  std::swap(m_scanned, other.m_scanned);
+  std::swap(m_error, other.m_error);
+  std::swap(m_malformed, other.m_malformed);
+  std::swap(m_index, other.m_index);
+  return *this;
+}
+
+TABPARSE_INLINE ConfigFile::~ConfigFile() {
+  if (m_data) {
+    ::munmap(const_cast<char*>(m_data), m_size);
+  }
+}
+
+TABPARSE_INLINE void ConfigFile::scan() {
+  m_scanned = true;
+  std::string_view rest{m_data, m_size};
+  while (!rest.empty()) {
+    auto newline = rest.find('\n');
+    auto text = config_file_detail::trim(rest.substr(0, newline));
+    rest.remove_prefix(newline == std::string_view::npos ? rest.size() : newline + 1);
+    if (text.empty() || text[0] == '#') {
+      continue;
+    }
+    auto equals = text.find('=');
+    if (equals == std::string_view::npos) {
+      if (m_malformed.empty()) {
+        m_malformed = text;
+      }
+      continue;
+    }
+    auto value = config_file_detail::trim(text.substr(equals + 1));
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"') {
+      value = value.substr(1, value.size() - 2);
+    }
+    m_index[config_file_detail::trim(text.substr(0, equals))].push_back(value);
+  }
+}
+
+TABPARSE_INLINE const std::vector<std::string_view>* ConfigFile::values(std::string_view key) {
+  if (!m_scanned) {
+    scan();
+  }
+  auto found = m_index.find(key);
+  return found == m_index.end() ? nullptr : &found->second;
+}
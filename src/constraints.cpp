@@ -0,0 +1,161 @@
+#include "constraints.h"
+#include "header_only.h"
+#include <algorithm>
+#include <stdexcept>
+
+TABPARSE_INLINE void ArgBase::set_required(bool required) {
+  if (required) {
+    m_flags.set(ArgFlags::Required);
+  } else {
+    m_flags.reset(ArgFlags::Required);
+  }
+  if (m_constraints) {
+    m_constraints->require(*this, required);
+  }
+}
+
+TABPARSE_INLINE void Constraints::set(Mask& mask, std::size_t slot) {
+  if (mask.size() <= slot / 64) {
+    mask.resize(slot / 64 + 1, 0);
+  }
+  mask[slot / 64] |= std::uint64_t{1} << (slot % 64);
+}
+
+TABPARSE_INLINE void Constraints::add(const ArgBase& arg, bool positional) {
+  if (m_args.size() <= arg.m_slot) {
+    m_args.resize(arg.m_slot + 1, nullptr);
+  }
+  m_args[arg.m_slot] = &arg;
+  if (positional) {
+    m_positionals.push_back(arg.m_slot);
+  }
+}
+
+TABPARSE_INLINE void Constraints::require(const ArgBase& arg, bool required) {
+  if (required) {
+    set(m_explicit, arg.m_slot);
+  } else if (test(m_explicit, arg.m_slot)) {
+    m_explicit[arg.m_slot / 64] &= ~(std::uint64_t{1} << (arg.m_slot % 64));
+  }
+  m_required = m_explicit;
+  // positional arguments before a required one are required as well
+  auto last = std::find_if(m_positionals.rbegin(), m_positionals.rend(), [this](std::size_t slot) { return test(m_explicit, slot); });
+  for (auto pos = last; pos != m_positionals.rend(); ++pos) {
+    set(m_required, *pos);
+  }
+}
+
+TABPARSE_INLINE const ArgBase& Constraints::own(const ArgBase* arg) const {
+  if (!arg || arg->m_slot >= m_args.size() || m_args[arg->m_slot] != arg) {
+    throw std::invalid_argument("constraints can only refer to arguments of the same parser.");
+  }
+  return *arg;
+}
+
+TABPARSE_INLINE void Constraints::add_rule(RuleKind kind, const ArgBase* trigger, std::initializer_list<const ArgBase*> members) {
+  Rule rule{kind, trigger, {}, {}, {}};
+  for (const ArgBase* member : members) {
+    const ArgBase& arg = own(member);
+    set(rule.members, arg.m_slot);
+    rule.args.push_back(&arg);
+    if (!rule.names.empty()) {
+      rule.names.append(", ");
+    }
+    rule.names.append(arg.label());
+  }
+  m_rules.push_back(std::move(rule));
+}
+
+TABPARSE_INLINE void Constraints::add_group(GroupKind kind, std::initializer_list<const ArgBase*> members) {
+  if (members.size() < 2) {
+    throw std::invalid_argument("a group needs at least two arguments.");
+  }
+  // exactly one is at most one and at least one
+  if (kind != +GroupKind::AtLeastOne) {
+    add_rule(RuleKind::AtMostOne, nullptr, members);
+    ++m_n_groups;
+  }
+  if (kind != +GroupKind::AtMostOne) {
+    add_rule(RuleKind::AtLeastOne, nullptr, members);
+  }
+}
+
+TABPARSE_INLINE void Constraints::add_dependency(const ArgBase& arg, std::initializer_list<const ArgBase*> needed) {
+  add_rule(RuleKind::Needs, &own(&arg), needed);
+}
+
+TABPARSE_INLINE void Constraints::check(const std::pmr::vector<std::uint64_t>& present, const ArgBase* skip,
+                                        std::pmr::vector<Diagnostic>& out) const {
+  for (std::size_t w = 0; w < m_required.size(); ++w) {
+    std::uint64_t missing = m_required[w] & ~(w < present.size() ? present[w] : 0);
+    for (; missing; missing &= missing - 1) {
+      const ArgBase* arg = m_args[w * 64 + std::size_t(__builtin_ctzll(missing))];
+      if (arg != skip) {
+        out.push_back({DiagnosticKind::MissingRequired, DiagnosticSource::CommandLine, arg, {}});
+      }
+    }
+  }
+  for (const auto& rule : m_rules) {
+    if (rule.kind == RuleKind::Needs && !test(present, rule.trigger->m_slot)) {
+      continue;
+    }
+    // the members given, or for Needs the members missing. The members are
+    // arguments registered before the parse, present covers all of them.
+    std::size_t n_hits = 0;
+    std::size_t first_hit = 0;
+    for (std::size_t w = std::min(rule.members.size(), present.size()); w-- > 0;) {
+      std::uint64_t hits = rule.members[w] & (rule.kind == RuleKind::Needs ? ~present[w] : present[w]);
+      if (hits) {
+        n_hits += std::size_t(__builtin_popcountll(hits));
+        first_hit = w * 64 + std::size_t(__builtin_ctzll(hits));
+      }
+    }
+    if (rule.kind == RuleKind::AtMostOne && n_hits > 1) {
+      // the next one given conflicts with the first
+      auto second = std::find_if(rule.args.begin(), rule.args.end(),
+                                 [&](const ArgBase* arg) { return arg->m_slot != first_hit && test(present, arg->m_slot); });
+      out.push_back({DiagnosticKind::Conflict, DiagnosticSource::CommandLine, *second, m_args[first_hit]->label()});
+    } else if (rule.kind == RuleKind::AtLeastOne && n_hits == 0) {
+      out.push_back({DiagnosticKind::MissingOneOf, DiagnosticSource::CommandLine, nullptr, rule.names});
+    } else if (rule.kind == RuleKind::Needs && n_hits != 0) {
+      out.push_back({DiagnosticKind::MissingDependency, DiagnosticSource::CommandLine, rule.trigger, m_args[first_hit]->label()});
+    }
+  }
+}
+
+TABPARSE_INLINE void Constraints::excluded(const Mask& present, Mask& out) const {
+  for (const auto& rule : m_rules) {
+    if (rule.kind != RuleKind::AtMostOne) {
+      continue;
+    }
+    std::size_t words = std::min(rule.members.size(), present.size());
+    bool given = false;
+    for (std::size_t w = 0; w < words && !given; ++w) {
+      given = (rule.members[w] & present[w]) != 0;
+    }
+    if (!given) {
+      continue;
+    }
+    if (out.size() < rule.members.size()) {
+      out.resize(rule.members.size(), 0);
+    }
+    for (std::size_t w = 0; w < rule.members.size(); ++w) {
+      out[w] |= rule.members[w] & ~(w < present.size() ? present[w] : 0);
+    }
+  }
+}
+
+TABPARSE_INLINE std::vector<const ArgBase*> Constraints::conflicts(const ArgBase& arg) const {
+  std::vector<const ArgBase*> others;
+  for (const auto& rule : m_rules) {
+    if (rule.kind != RuleKind::AtMostOne || !test(rule.members, arg.m_slot)) {
+      continue;
+    }
+    for (const ArgBase* member : rule.args) {
+      if (member != &arg && std::find(others.begin(), others.end(), member) == others.end()) {
+        others.push_back(member);
+      }
+    }
+  }
+  return others;
+}
@@ -0,0 +1,100 @@
+#include "flag_trie.h"
+#include "header_only.h"
+#include <algorithm>
+#include <utility>
+
+TABPARSE_INLINE void FlagTrie::insert(std::string_view name, std::uint32_t value) {
+  std::uint32_t node = 0;
+  for (char c : name) {
+    std::uint32_t child = m_nodes[node].child;
+    while (child != npos && m_nodes[child].label != c) {
+      child = m_nodes[child].sibling;
+    }
+    if (child == npos) {
+      Node fresh;
+      fresh.label = c;
+      fresh.sibling = m_nodes[node].child;
+      fresh.unique = value;
+      child = std::uint32_t(m_nodes.size());
+      m_nodes.push_back(fresh);
+      m_nodes[node].child = child;
+    } else {
+      // every existing node already has a name below it
+      m_nodes[child].unique = npos;
+    }
+    node = child;
+  }
+  m_nodes[node].value = value;
+  m_longest = std::max(m_longest, name.size());
+}
+
+TABPARSE_INLINE std::uint32_t FlagTrie::walk(std::string_view text) const {
+  std::uint32_t node = 0;
+  for (char c : text) {
+    node = m_nodes[node].child;
+    while (node != npos && m_nodes[node].label != c) {
+      node = m_nodes[node].sibling;
+    }
+    if (node == npos) {
+      return npos;
+    }
+  }
+  return node;
+}
+
+TABPARSE_INLINE std::uint32_t FlagTrie::find(std::string_view name) const {
+  std::uint32_t node = walk(name);
+  return node == npos ? npos : m_nodes[node].value;
+}
+
+TABPARSE_INLINE std::uint32_t FlagTrie::complete(std::string_view prefix) const {
+  std::uint32_t node = walk(prefix);
+  if (node == npos) {
+    return npos;
+  }
+  // an exact name wins over the longer ones it is a prefix of
+  return m_nodes[node].value != npos ? m_nodes[node].value : m_nodes[node].unique;
+}
+
+TABPARSE_INLINE std::uint32_t FlagTrie::closest(std::string_view token, std::size_t max_distance) const {
+  // Levenshtein rows of the prefix ending at each node against token, one
+  // row per depth of the depth first walk
+  const std::size_t width = token.size() + 1;
+  std::vector<std::size_t> rows((m_longest + 1) * width);
+  for (std::size_t j = 0; j < width; ++j) {
+    rows[j] = j;
+  }
+  std::uint32_t best = npos;
+  std::size_t best_distance = max_distance + 1;
+  std::vector<std::pair<std::uint32_t, std::size_t>> stack;
+  for (std::uint32_t child = m_nodes[0].child; child != npos; child = m_nodes[child].sibling) {
+    stack.emplace_back(child, 1);
+  }
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    const std::size_t* above = &rows[(depth - 1) * width];
+    std::size_t* row = &rows[depth * width];
+    row[0] = depth;
+    std::size_t row_min = row[0];
+    for (std::size_t j = 1; j < width; ++j) {
+      std::size_t substitute = above[j - 1] + (token[j - 1] == m_nodes[node].label ? 0 : 1);
+      row[j] = std::min({above[j] + 1, row[j - 1] + 1, substitute});
+      row_min = std::min(row_min, row[j]);
+    }
+    const Node& current = m_nodes[node];
+    if (current.value != npos && row[width - 1] <= max_distance &&
+        (row[width - 1] < best_distance || (row[width - 1] == best_distance && current.value < best))) {
+      best = current.value;
+      best_distance = row[width - 1];
+    }
+    // distances only grow below this node
+    if (row_min > best_distance) {
+      continue;
+    }
+    for (std::uint32_t child = current.child; child != npos; child = m_nodes[child].sibling) {
+      stack.emplace_back(child, depth + 1);
+    }
+  }
+  return best;
+}
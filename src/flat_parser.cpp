@@ -0,0 +1,233 @@
+#include "flat_parser.h"
+#include "header_only.h"
+#include "output.h"
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <unistd.h>
+
+TABPARSE_INLINE FlatParser::FlatParser(std::pmr::memory_resource* resource)
+    : m_args{resource}, m_lookup{resource}, m_positionals{resource}, m_required{resource},
+      m_present{resource}, m_values{resource}, m_repeated{resource} {
+  // like the Parser constructor, but --help is only a descriptor
+  add(StaticArg::Switch("--help", "Print help message."));
+}
+
+TABPARSE_INLINE void FlatParser::reserve(std::size_t n_args) {
+  n_args += m_args.size();
+  m_args.reserve(n_args);
+  m_values.reserve(n_args);
+  m_repeated.reserve(n_args);
+  auto lookup_size = static_schema_detail::lookup_size(n_args);
+  if (lookup_size > m_lookup.size()) {
+    m_lookup.assign(lookup_size, 0);
+    for (std::size_t i = 0; i < m_args.size(); ++i) {
+      insert(i);
+    }
+  }
+}
+
+TABPARSE_INLINE std::size_t FlatParser::add(const StaticArg& arg) {
+  std::size_t idx = m_args.size();
+  if (arg.role == +ArgRole::Flag) {
+    if (arg.name.empty() || arg.name[0] != '-') {
+      throw std::invalid_argument(fmt::format("flag arguments should start with - or --. {} does not.", arg.name));
+    }
+    if (find_flag(arg.name) != idx) {
+      throw std::invalid_argument(fmt::format("option with name {} already exists", arg.name));
+    }
+  } else if (arg.role == +ArgRole::Others && m_others != idx) {
+    throw std::invalid_argument("only one argument can take the remaining positional arguments.");
+  }
+  if (m_others == idx && arg.role != +ArgRole::Others) {
+    // still none, keep pointing past the end
+    ++m_others;
+  }
+  m_args.push_back(arg);
+  m_values.push_back(arg.default_string);
+  m_repeated.emplace_back();
+  // keep the table at most half full, as build_lookup does
+  auto lookup_size = static_schema_detail::lookup_size(m_args.size());
+  if (lookup_size > m_lookup.size()) {
+    m_lookup.assign(lookup_size, 0);
+    for (std::size_t i = 0; i < m_args.size(); ++i) {
+      insert(i);
+    }
+  } else {
+    insert(idx);
+  }
+  if (idx % 64 == 0) {
+    m_required.push_back(0);
+    m_present.push_back(0);
+  }
+  if (arg.is_required) {
+    m_required[idx / 64] |= std::uint64_t{1} << (idx % 64);
+  }
+  if (arg.role == +ArgRole::Positional) {
+    m_positionals.push_back(std::uint32_t(idx));
+    // same semantics as Parser::sanitize: positional arguments before a
+    // required one are required as well
+    if (arg.is_required) {
+      for (auto pos = m_positionals.rbegin() + 1; pos != m_positionals.rend(); ++pos) {
+        auto& word = m_required[*pos / 64];
+        auto bit = std::uint64_t{1} << (*pos % 64);
+        if (word & bit) {
+          break;
+        }
+        word |= bit;
+      }
+    }
+  }
+  return idx;
+}
+
+TABPARSE_INLINE void FlatParser::insert(std::size_t idx) {
+  if (m_args[idx].role != +ArgRole::Flag) {
+    return;
+  }
+  std::size_t mask = m_lookup.size() - 1;
+  std::size_t slot = static_schema_detail::hash(m_args[idx].name) & mask;
+  while (m_lookup[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  m_lookup[slot] = std::uint32_t(idx + 1);
+}
+
+TABPARSE_INLINE std::size_t FlatParser::find_flag(std::string_view token) const {
+  if (m_lookup.empty()) {
+    return m_args.size();
+  }
+  std::size_t mask = m_lookup.size() - 1;
+  for (std::size_t slot = static_schema_detail::hash(token) & mask; m_lookup[slot] != 0; slot = (slot + 1) & mask) {
+    if (m_args[m_lookup[slot] - 1].name == token) {
+      return m_lookup[slot] - 1;
+    }
+  }
+  return m_args.size();
+}
+
+TABPARSE_INLINE std::size_t FlatParser::index(std::string_view name) const {
+  for (std::size_t i = 0; i < m_args.size(); ++i) {
+    if (m_args[i].name == name) {
+      return i;
+    }
+  }
+  throw std::invalid_argument(fmt::format("no argument with name {} registered.", name));
+}
+
+TABPARSE_INLINE void FlatParser::store(std::size_t idx, std::string_view value) {
+  const auto& arg = m_args[idx];
+  static_schema_detail::check_value(arg, value);
+  m_present[idx / 64] |= std::uint64_t{1} << (idx % 64);
+  if (arg.repeated) {
+    m_repeated[idx].push_back(value);
+  } else {
+    m_values[idx] = value;
+  }
+}
+
+TABPARSE_INLINE void FlatParser::parse(int argc, char* argv[]) {
+  // nothing of an earlier command line stays, the repeated values keep
+  // their storage
+  std::fill(m_present.begin(), m_present.end(), 0);
+  for (auto& values : m_repeated) {
+    values.clear();
+  }
+  const ArgIter begin{argv + 1};
+  const ArgIter end{argv + argc};
+  const std::size_t n_args = m_args.size();
+  std::size_t next_positional = 0;
+  bool had_operand = false;
+  for (auto iter = begin; iter != end;) {
+    std::size_t idx = find_flag(*iter);
+    // --help (added first by the constructor) in place of a flag, not as a
+    // value, and complete as the first operand, as Parser takes them
+    if (idx == 0) {
+      print_help(argv[0]);
+      return;
+    }
+    if (idx == n_args && !had_operand && *iter == "complete") {
+      print_completion(argv[0]);
+      return;
+    }
+    if (idx != n_args) {
+      ++iter;
+      if (m_args[idx].kind == +ArgKind::Switch) {
+        m_present[idx / 64] |= std::uint64_t{1} << (idx % 64);
+        continue;
+      }
+      if (iter == end) {
+        throw std::invalid_argument(fmt::format("missing value for {}.", m_args[idx].name));
+      }
+      store(idx, *iter++);
+      continue;
+    }
+    had_operand = true;
+    if (next_positional != m_positionals.size()) {
+      store(m_positionals[next_positional++], *iter++);
+      continue;
+    }
+    if (m_others == n_args) {
+      throw std::invalid_argument(fmt::format("no more positional arguments expected, received {}.", *iter));
+    }
+    // the remaining tokens are all overflow values, also those that look like
+    // flags. Unlike Parser, flags can not follow the first of them.
+    m_repeated[m_others].reserve(m_repeated[m_others].size() + std::size_t(end - iter));
+    for (; iter != end; ++iter) {
+      store(m_others, *iter);
+    }
+  }
+  for (std::size_t w = 0; w < m_required.size(); ++w) {
+    std::uint64_t missing = m_required[w] & ~m_present[w];
+    if (missing) {
+      const auto& arg = m_args[w * 64 + std::size_t(__builtin_ctzll(missing))];
+      throw std::invalid_argument(fmt::format("required argument {} not used.",
+                                              arg.role == +ArgRole::Flag ? arg.name : arg.shortdoc));
+    }
+  }
+}
+
+TABPARSE_INLINE long FlatParser::int_value(std::size_t idx) const {
+  if (m_args[idx].repeated) {
+    const auto& values = m_repeated[idx];
+    return values.empty() ? m_args[idx].default_int : parse_number<long>(values.back());
+  }
+  return present(idx) ? parse_number<long>(m_values[idx]) : m_args[idx].default_int;
+}
+
+TABPARSE_INLINE std::string_view FlatParser::string_value(std::size_t idx) const {
+  if (m_args[idx].repeated) {
+    const auto& values = m_repeated[idx];
+    return values.empty() ? m_args[idx].default_string : values.back();
+  }
+  // a value of an earlier parse may point into an argv that is gone
+  return present(idx) ? m_values[idx] : m_args[idx].default_string;
+}
+
+TABPARSE_INLINE void FlatParser::render_help(fmt::memory_buffer& out, std::string_view appname, std::size_t width) const {
+  static_schema_detail::render_help(out, appname, m_args.data(), m_args.data() + m_args.size(), m_required.data(), width);
+}
+
+TABPARSE_INLINE void FlatParser::print_help(std::string_view appname) const {
+  fmt::memory_buffer out;
+  render_help(out, appname, terminal_width(STDOUT_FILENO));
+  write_buffer(STDOUT_FILENO, {out.data(), out.size()});
+}
+
+TABPARSE_INLINE void FlatParser::render_completion(fmt::memory_buffer& out, std::string_view appname) const {
+  if (appname.substr(0, 2) == "./") {
+    appname.remove_prefix(2);
+  }
+  fmt::format_to(std::back_inserter(out), "#compdef {}\n\n", appname);
+  static_schema_detail::BufferSink sink{out};
+  static_schema_detail::put_arguments(sink, m_args.data(), m_args.data() + m_args.size());
+}
+
+TABPARSE_INLINE void FlatParser::print_completion(std::string_view appname) const {
+  fmt::memory_buffer out;
+  render_completion(out, appname);
+  if (appname.substr(0, 2) == "./") {
+    appname.remove_prefix(2);
+  }
+  write_buffer(fmt::format("_{}", appname), {out.data(), out.size()});
+}
@@ -0,0 +1,288 @@
+#include "numeric.h"
+#include "header_only.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+#include <type_traits>
+
+namespace numeric_detail {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+inline constexpr bool swar = true;
+#else
+inline constexpr bool swar = false;
+#endif
+// decimal digits that always fit 64 bits
+inline constexpr std::ptrdiff_t safe_digits = 19;
+
+TABPARSE_INLINE bool is_digit(char c) {
+  return static_cast<unsigned char>(c - '0') < 10;
+}
+
+// the value of the eight digits at pos, false if they are not all digits
+TABPARSE_INLINE bool eight_digits(const char* pos, std::uint64_t& value) {
+  std::uint64_t chunk;
+  std::memcpy(&chunk, pos, sizeof(chunk));
+  // in every byte: the high nibble is 3, and adding 6 does not change that
+  if ((chunk & 0xF0F0F0F0F0F0F0F0) != 0x3030303030303030 ||
+      ((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) != 0x3030303030303030) {
+    return false;
+  }
+  // combine neighbouring digits, then pairs of those, then quadruples
+  chunk = ((chunk & 0x0F0F0F0F0F0F0F0F) * 2561) >> 8;
+  chunk = ((chunk & 0x00FF00FF00FF00FF) * 6553601) >> 16;
+  value = ((chunk & 0x0000FFFF0000FFFF) * 42949672960001) >> 32;
+  return true;
+}
+
+TABPARSE_INLINE std::errc parse_magnitude(const char*& pos, const char* last, std::uint64_t& value) {
+  int base = 10;
+  if (last - pos > 1 && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X')) {
+    base = 16;
+    pos += 2;
+  } else if (last - pos > 1 && pos[0] == '0' && is_digit(pos[1])) {
+    base = 8;
+    pos += 1;
+  }
+  if (base == 10) {
+    const char* digits = pos;
+    value = 0;
+    if constexpr (swar) {
+      std::uint64_t chunk;
+      while (last - pos >= 8 && pos - digits + 8 <= safe_digits && eight_digits(pos, chunk)) {
+        value = value * 100000000 + chunk;
+        pos += 8;
+      }
+    }
+    while (pos != last && is_digit(*pos) && pos - digits < safe_digits) {
+      value = value * 10 + std::uint64_t(*pos - '0');
+      ++pos;
+    }
+    if (pos == digits) {
+      return std::errc::invalid_argument;
+    }
+    if (pos == last || !is_digit(*pos)) {
+      return std::errc{};
+    }
+    // too many digits for the fast path, from_chars checks for overflow
+    pos = digits;
+  }
+  auto [end, ec] = std::from_chars(pos, last, value, base);
+  pos = end;
+  return ec;
+}
+
+template <typename NUMBER>
+std::errc parse_one(const char*& pos, const char* last, NUMBER& value) {
+  bool negative = false;
+  if (pos != last && (*pos == '-' || *pos == '+')) {
+    negative = *pos++ == '-';
+    // from_chars would take a second minus
+    if (pos != last && (*pos == '-' || *pos == '+')) {
+      return std::errc::invalid_argument;
+    }
+  }
+  if constexpr (std::is_floating_point_v<NUMBER>) {
+    auto [end, ec] = std::from_chars(pos, last, value);
+    pos = end;
+    value = negative ? -value : value;
+    return ec;
+  } else {
+    if (negative && !std::is_signed_v<NUMBER>) {
+      return std::errc::result_out_of_range;
+    }
+    std::uint64_t magnitude;
+    if (auto ec = parse_magnitude(pos, last, magnitude); ec != std::errc{}) {
+      return ec;
+    }
+    using unsigned_type = std::make_unsigned_t<NUMBER>;
+    std::uint64_t limit = std::uint64_t(std::numeric_limits<NUMBER>::max()) + (negative ? 1 : 0);
+    if (magnitude > limit) {
+      return std::errc::result_out_of_range;
+    }
+    value = NUMBER(negative ? unsigned_type(0) - unsigned_type(magnitude) : unsigned_type(magnitude));
+    return std::errc{};
+  }
+}
+
+TABPARSE_INLINE void throw_on(std::errc ec, std::string_view token) {
+  if (ec == std::errc::result_out_of_range) {
+    throw std::invalid_argument(fmt::format("{} is out of range.", token));
+  }
+  if (ec != std::errc{}) {
+    throw std::invalid_argument(fmt::format("could not parse {} as number.", token));
+  }
+}
+}
+
+template <typename NUMBER>
+NUMBER parse_number(std::string_view token) {
+  const char* pos = token.data();
+  const char* last = token.data() + token.size();
+  NUMBER value{};
+  numeric_detail::throw_on(numeric_detail::parse_one(pos, last, value), token);
+  if (pos != last) {
+    numeric_detail::throw_on(std::errc::invalid_argument, token);
+  }
+  return value;
+}
+
+namespace numeric_detail {
+// parse_number_list without the exceptions: ec tells for ListError::Number,
+// first and final the range for Descending
+template <typename NUMBER>
+ListError scan_list(std::string_view token, std::pmr::vector<NUMBER>* out, std::size_t& count, std::errc& ec,
+                    NUMBER& first, NUMBER& final) {
+  const char* pos = token.data();
+  const char* last = token.data() + token.size();
+  count = 0;
+  for (;;) {
+    if ((ec = parse_one(pos, last, first)) != std::errc{}) {
+      return ListError::Number;
+    }
+    if (pos != last && *pos == '-') {
+      if constexpr (std::is_floating_point_v<NUMBER>) {
+        return ListError::FloatRange;
+      } else {
+        ++pos;
+        if ((ec = parse_one(pos, last, final)) != std::errc{}) {
+          return ListError::Number;
+        }
+        if (final < first) {
+          return ListError::Descending;
+        }
+        using unsigned_type = std::make_unsigned_t<NUMBER>;
+        auto span = unsigned_type(unsigned_type(final) - unsigned_type(first));
+        if (span >= max_list_values - count) {
+          return ListError::TooLarge;
+        }
+        count += std::size_t(span) + 1;
+        if (out) {
+          auto old_size = out->size();
+          out->resize(old_size + std::size_t(span) + 1);
+          // stops at final, one more increment could overflow
+          auto* into = out->data() + old_size;
+          for (NUMBER value = first;; ++value) {
+            *into++ = value;
+            if (value == final) {
+              break;
+            }
+          }
+        }
+      }
+    } else {
+      if (++count > max_list_values) {
+        return ListError::TooLarge;
+      }
+      if (out) {
+        out->push_back(first);
+      }
+    }
+    if (pos == last) {
+      return ListError::None;
+    }
+    if (*pos++ != ',' || pos == last) {
+      ec = std::errc::invalid_argument;
+      return ListError::Number;
+    }
+  }
+}
+}
+
+template <typename NUMBER>
+std::size_t parse_number_list(std::string_view token, std::pmr::vector<NUMBER>* out) {
+  std::size_t count;
+  std::errc ec{};
+  NUMBER first{};
+  NUMBER final{};
+  switch (numeric_detail::scan_list(token, out, count, ec, first, final)) {
+    case ListError::None:
+      return count;
+    case ListError::Number:
+      numeric_detail::throw_on(ec, token);
+      break;
+    case ListError::FloatRange:
+      throw std::invalid_argument(fmt::format("{}: ranges are only supported for integers.", token));
+    case ListError::Descending:
+      throw std::invalid_argument(fmt::format("{}: range {}-{} is descending.", token, first, final));
+    case ListError::TooLarge:
+      throw std::invalid_argument(fmt::format("{}: stands for more than {} numbers.", token, max_list_values));
+  }
+  return count;
+}
+
+template <typename NUMBER>
+std::errc check_number(std::string_view token) {
+  const char* pos = token.data();
+  const char* last = token.data() + token.size();
+  NUMBER value{};
+  auto ec = numeric_detail::parse_one(pos, last, value);
+  return ec == std::errc{} && pos != last ? std::errc::invalid_argument : ec;
+}
+
+template <typename NUMBER>
+ListError check_number_list(std::string_view token, std::errc& ec) {
+  std::size_t count;
+  NUMBER first{};
+  NUMBER final{};
+  return numeric_detail::scan_list<NUMBER>(token, nullptr, count, ec, first, final);
+}
+
+TABPARSE_INLINE std::string_view descending_range(std::string_view token) {
+  // sign and magnitude of each end, such that one comparison covers every
+  // integer type
+  auto read_end = [](const char*& pos, const char* last, bool& negative, std::uint64_t& magnitude) {
+    negative = pos != last && *pos == '-';
+    if (pos != last && (*pos == '-' || *pos == '+')) {
+      ++pos;
+    }
+    if (numeric_detail::parse_magnitude(pos, last, magnitude) != std::errc{}) {
+      return false;
+    }
+    // -0 is 0
+    negative = negative && magnitude != 0;
+    return true;
+  };
+  while (!token.empty()) {
+    auto item = token.substr(0, token.find(','));
+    token.remove_prefix(std::min(token.size(), item.size() + 1));
+    const char* pos = item.data();
+    const char* last = item.data() + item.size();
+    bool first_negative;
+    bool final_negative;
+    std::uint64_t first;
+    std::uint64_t final;
+    if (!read_end(pos, last, first_negative, first) || pos == last || *pos++ != '-' ||
+        !read_end(pos, last, final_negative, final)) {
+      continue;
+    }
+    bool descending = first_negative != final_negative ? final_negative : (first_negative ? final > first : final < first);
+    if (descending) {
+      return item;
+    }
+  }
+  return {};
+}
+
+// the number types of NumericArg and the static schema, header-only builds
+// instantiate whatever they use
+#ifndef TABPARSE_HEADER_ONLY
+#define TABPARSE_NUMERIC(NUMBER) \
+  template NUMBER parse_number<NUMBER>(std::string_view); \
+  template std::size_t parse_number_list<NUMBER>(std::string_view, std::pmr::vector<NUMBER>*); \
+  template std::errc check_number<NUMBER>(std::string_view); \
+  template ListError check_number_list<NUMBER>(std::string_view, std::errc&);
+TABPARSE_NUMERIC(int)
+TABPARSE_NUMERIC(unsigned)
+TABPARSE_NUMERIC(long)
+TABPARSE_NUMERIC(unsigned long)
+TABPARSE_NUMERIC(long long)
+TABPARSE_NUMERIC(unsigned long long)
+TABPARSE_NUMERIC(float)
+TABPARSE_NUMERIC(double)
+#undef TABPARSE_NUMERIC
+#endif
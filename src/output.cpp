@@ -0,0 +1,223 @@
+#include "output.h"
+#include "header_only.h"
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fmt/ranges.h>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <sys/ioctl.h>
+#include <system_error>
+#include <unistd.h>
+
+TABPARSE_INLINE void write_buffer(int fd, std::string_view data) {
+  // a single write unless the kernel accepts less (pipes, signals)
+  while (!data.empty()) {
+    auto written = ::write(fd, data.data(), data.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw std::system_error(errno, std::generic_category(), "could not write output");
+    }
+    data.remove_prefix(std::size_t(written));
+  }
+}
+
+TABPARSE_INLINE void write_buffer(std::string_view path, std::string_view data) {
+  std::string fname{path};
+  int fd = ::open(fname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(), fmt::format("could not open {}", path));
+  }
+  try {
+    write_buffer(fd, data);
+  } catch (...) {
+    ::close(fd);
+    throw;
+  }
+  ::close(fd);
+}
+
+TABPARSE_INLINE bool file_starts_with(std::string_view path, std::string_view prefix) {
+  std::string fname{path};
+  int fd = ::open(fname.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  std::string head(prefix.size(), '\0');
+  std::size_t filled = 0;
+  while (filled < head.size()) {
+    auto got = ::read(fd, head.data() + filled, head.size() - filled);
+    if (got < 0 && errno == EINTR) {
+      continue;
+    }
+    if (got <= 0) {
+      break;
+    }
+    filled += std::size_t(got);
+  }
+  ::close(fd);
+  return filled == head.size() && head == prefix;
+}
+
+TABPARSE_INLINE std::size_t terminal_width(int fd) {
+  winsize ws{};
+  if (::isatty(fd) && ::ioctl(fd, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0) {
+    return ws.ws_col;
+  }
+  if (const char* columns = std::getenv("COLUMNS")) {
+    return std::strtoul(columns, nullptr, 10);
+  }
+  return 0;
+}
+
+TABPARSE_INLINE void append_wrapped(fmt::memory_buffer& out, std::string_view text, std::size_t column, std::size_t width) {
+  // too narrow to wrap into anything readable
+  if (width == 0 || column + 20 > width) {
+    out.append(text.data(), text.data() + text.size());
+    return;
+  }
+  std::size_t current = column;
+  bool line_start = true;
+  while (!text.empty()) {
+    auto word_end = text.find(' ');
+    auto word = text.substr(0, word_end);
+    text.remove_prefix(word_end == std::string_view::npos ? text.size() : word_end + 1);
+    if (word.empty()) {
+      continue;
+    }
+    if (!line_start && current + 1 + word.size() > width) {
+      out.push_back('\n');
+      for (std::size_t i = 0; i < column; ++i) {
+        out.push_back(' ');
+      }
+      current = column;
+      line_start = true;
+    }
+    if (!line_start) {
+      out.push_back(' ');
+      ++current;
+    }
+    out.append(word.data(), word.data() + word.size());
+    current += word.size();
+    line_start = false;
+  }
+}
+
+TABPARSE_INLINE void append_candidate(fmt::memory_buffer& out, std::string_view value, std::string_view description) {
+  for (char c : value) {
+    if (c == ':' || c == '\\') {
+      out.push_back('\\');
+    }
+    out.push_back(c);
+  }
+  if (!description.empty()) {
+    out.push_back(':');
+    for (char c : description) {
+      out.push_back(c == '\n' ? ' ' : c);
+    }
+  }
+  out.push_back('\n');
+}
+
+TABPARSE_INLINE void append_quoted(fmt::memory_buffer& out, std::string_view text) {
+  out.push_back('\'');
+  for (char c : text) {
+    if (c == '\'') {
+      // close the quotes, an escaped quote, reopen
+      fmt::format_to(std::back_inserter(out), "'\\''");
+    } else {
+      out.push_back(c == '\n' ? ' ' : c);
+    }
+  }
+  out.push_back('\'');
+}
+
+TABPARSE_INLINE std::string choice_function_name(std::string_view title, const std::vector<std::string>& values,
+                                                 const std::vector<std::string>& descriptions) {
+  std::uint64_t hash = fingerprint(title);
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    hash = fingerprint(values[i], fingerprint("\n", hash));
+    if (!descriptions.empty()) {
+      hash = fingerprint(descriptions[i], fingerprint(":", hash));
+    }
+  }
+  return fmt::format("_tabparse_choices_{:016x}", hash);
+}
+
+TABPARSE_INLINE void append_choice_action(fmt::memory_buffer& out, std::string_view title, const std::vector<std::string>& values,
+                                          const std::vector<std::string>& descriptions, std::size_t helper_threshold) {
+  auto outiter = std::back_inserter(out);
+  if (values.size() > helper_threshold) {
+    fmt::format_to(outiter, "{}", choice_function_name(title, values, descriptions));
+  } else if (descriptions.empty()) {
+    fmt::format_to(outiter, "({})", fmt::join(values, " "));
+  } else {
+    fmt::format_to(outiter, "((");
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      fmt::format_to(outiter, "{}{}\\:'{}'", i == 0 ? "" : " ", values[i], descriptions[i]);
+    }
+    fmt::format_to(outiter, "))");
+  }
+}
+
+TABPARSE_INLINE void append_choice_function(fmt::memory_buffer& out, std::string_view title, const std::vector<std::string>& values,
+                                            const std::vector<std::string>& descriptions) {
+  auto name = choice_function_name(title, values, descriptions);
+  // the array has the name of the function, the cache that without the
+  // leading underscore
+  std::string_view cache = std::string_view{name}.substr(1);
+  fmt::format_to(std::back_inserter(out),
+                 "(( $+functions[{0}] )) ||\n"
+                 "{0}() {{\n"
+                 "  if (( ! $+{0} )) && ! _retrieve_cache {1}; then\n"
+                 "    typeset -ga {0}\n"
+                 "    {0}=(\n",
+                 name, cache);
+  fmt::memory_buffer entry;
+  for (std::size_t i = 0; i < values.size(); ++i) {
+    entry.clear();
+    append_candidate(entry, values[i], descriptions.empty() ? std::string_view{} : descriptions[i]);
+    fmt::format_to(std::back_inserter(out), "      ");
+    append_quoted(out, {entry.data(), entry.size() - 1});
+    out.push_back('\n');
+  }
+  fmt::format_to(std::back_inserter(out),
+                 "    )\n"
+                 "    _store_cache {1} {0}\n"
+                 "  fi\n"
+                 "  _describe -t values ",
+                 name, cache);
+  append_quoted(out, title);
+  fmt::format_to(std::back_inserter(out), " {}\n}}\n\n", name);
+}
+
+TABPARSE_INLINE void append_dynamic_query(fmt::memory_buffer& out, std::string_view indent) {
+  fmt::format_to(std::back_inserter(out),
+                 "{0}local -a reply candidates all_words\n"
+                 "{0}local -i current=$CURRENT\n"
+                 "{0}if (( $+{2} )); then\n"
+                 "{0}  # words starts at a subcommand, the program wants all of them\n"
+                 "{0}  all_words=(\"${{(@){2}}}\")\n"
+                 "{0}  (( current += ${{#{2}}} - ${{#words}} ))\n"
+                 "{0}else\n"
+                 "{0}  all_words=(\"${{(@)words}}\")\n"
+                 "{0}fi\n"
+                 "{0}reply=(\"${{(@f)$(${{(Q)all_words[1]}} {1} $current \"${{(Q)all_words[@]}}\" 2>/dev/null)}}\")\n"
+                 "{0}local kind=${{reply[1]%% *}} detail=${{reply[1]#* }}\n"
+                 "{0}case $kind in\n"
+                 "{0}  describe) candidates=(\"${{(@)reply[2,-1]}}\"); _describe -t values \"$detail\" candidates ;;\n"
+                 "{0}  files) _files -g \"$detail\" ;;\n"
+                 "{0}  directories) _files -/ ;;\n"
+                 "{0}  message) _message \"$detail\" ;;\n"
+                 "{0}esac\n",
+                 indent, dynamic_complete_keyword, query_words_name);
+}
+
+TABPARSE_INLINE void append_query_function(fmt::memory_buffer& out) {
+  fmt::format_to(std::back_inserter(out), "(( $+functions[{0}] )) ||\n{0}() {{\n", query_function_name);
+  append_dynamic_query(out, "  ");
+  fmt::format_to(std::back_inserter(out), "}}\n\n");
+}
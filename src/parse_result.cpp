@@ -0,0 +1,33 @@
+#include "parse_result.h"
+#include "header_only.h"
+
+TABPARSE_INLINE void ParseResult::reset(std::size_t n_slots) {
+  if (m_values.size() != n_slots) {
+    m_values.clear();
+    m_values.resize(n_slots);
+    m_touched.clear();
+  }
+  for (auto slot : m_touched) {
+    m_values[slot].clear();
+  }
+  m_touched.clear();
+  m_paths.clear();
+  m_present.assign((n_slots + 63) / 64, 0);
+  m_help = false;
+  m_complete = false;
+  m_config.reset();
+  m_command = {};
+  m_command_begin = m_command_end = ArgIter{};
+  m_diagnostics.clear();
+  m_error.clear();
+}
+
+TABPARSE_INLINE const std::vector<PathInfo>& ParseResult::paths(const ArgBase* arg) const {
+  static const std::vector<PathInfo> none;
+  for (const auto& [slot, infos] : m_paths) {
+    if (slot == arg->m_slot) {
+      return infos;
+    }
+  }
+  return none;
+}
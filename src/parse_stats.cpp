@@ -0,0 +1,60 @@
+#include "parse_stats.h"
+#include "header_only.h"
+#include "output.h"
+#include <atomic>
+#include <cstdlib>
+#include <iterator>
+#include <unistd.h>
+
+namespace parse_stats_detail {
+TABPARSE_INLINE bool requested_by_environment() {
+  static const bool requested = std::getenv("TABPARSE_STATS") != nullptr;
+  return requested;
+}
+
+TABPARSE_INLINE std::atomic<bool>& enabled() {
+  static std::atomic<bool> flag{requested_by_environment()};
+  return flag;
+}
+}
+
+TABPARSE_INLINE void ParseStats::render_json(fmt::memory_buffer& out) const {
+  auto outiter = std::back_inserter(out);
+  out.push_back('{');
+  for (std::size_t i = 0; i < phases.size(); ++i) {
+    const auto& phase = phases[i];
+    fmt::format_to(outiter, "{}\"{}\": {{\"calls\": {}, \"ns\": {}, \"allocations\": {}}}", i == 0 ? "" : ", ",
+                   ParsePhase::_names()[i], phase.calls, phase.ns, phase.allocations);
+  }
+  out.push_back('}');
+}
+
+TABPARSE_INLINE ParseStats& parse_stats() {
+  thread_local ParseStats stats;
+  return stats;
+}
+
+TABPARSE_INLINE void reset_parse_stats() {
+  parse_stats() = ParseStats{};
+}
+
+TABPARSE_INLINE void enable_parse_stats(bool enable) {
+  parse_stats_detail::enabled().store(enable, std::memory_order_relaxed);
+}
+
+TABPARSE_INLINE bool parse_stats_enabled() {
+  return parse_stats_detail::enabled().load(std::memory_order_relaxed);
+}
+
+TABPARSE_INLINE void dump_parse_stats() {
+#ifdef TABPARSE_STATS
+  if (!parse_stats_detail::requested_by_environment()) {
+    return;
+  }
+  fmt::memory_buffer out;
+  fmt::format_to(std::back_inserter(out), "{{\"tabparse_stats\": ");
+  parse_stats().render_json(out);
+  fmt::format_to(std::back_inserter(out), "}}\n");
+  write_buffer(STDERR_FILENO, {out.data(), out.size()});
+#endif
+}
@@ -1,4 +1,6 @@
 #include "parser.h"
+#include "header_only.h"
+#include "parse_stats.h"
 #include "v_opt.h"
 #include <iterator>
 #include <stdexcept>
@@ -7,116 +9,532 @@
 #include <vector>
 #include <memory>
 #include <algorithm>
-#include <regex>
-#include <iostream>
-#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <optional>
+#include <unistd.h>
 #include <fmt/format.h>
+#include "output.h"
 
-template <typename ARGTYPE, typename ...OTHERARGS>
-ARGTYPE*
-Parser::addArg(std::string_view name, typename ARGTYPE::type default_value,
-               std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
-  auto findres = std::find_if(m_args.begin(), m_args.end(),
-                              [name](const auto &existing_arg) {
-                                return existing_arg->m_name == name;
-                              });
-  if (m_args.end() != findres) {
-    throw std::invalid_argument(fmt::format("option with name {} already exists", name));
-  }
-  if (name[0] != '-') {
-    throw std::invalid_argument(fmt::format("flag arguments should start with - or --. {} does not.", name));
-  }
-  auto thearg = std::make_unique<ARGTYPE>(name, std::move(default_value), shortdoc, doc, std::forward<OTHERARGS>(otherargs)...);
-  m_args.push_back(std::move(thearg));
-  return static_cast<ARGTYPE*>(m_args.back().get());
-}
-
-template <typename ARGTYPE, typename ...OTHERARGS>
-ARGTYPE*
-Parser::addPosArg(typename ARGTYPE::type default_value,
-                  std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
-  auto thearg = std::make_unique<ARGTYPE>(fmt::format("{}", m_pos.size()+1), std::move(default_value), shortdoc, doc, std::forward<OTHERARGS>(otherargs)...);
-  m_pos.push_back(std::move(thearg));
-  return static_cast<ARGTYPE*>(m_pos.back().get());
-}
-
-template <typename BASE_ARG, typename ...OTHERARGS>
-MultiArg<BASE_ARG>* Parser::addOther(std::string_view shortdoc, std::string_view doc, OTHERARGS... otherargs) {
-  m_others = std::make_unique<MultiArg<BASE_ARG>>("*", typename BASE_ARG::type{}, shortdoc, doc, std::forward<OTHERARGS>(otherargs)...);
-  return static_cast<MultiArg<BASE_ARG>*>(m_others.get());
-}
-
-void Parser::print_completion(std::string_view appname) {
-  std::ofstream outfile;
-  std::string fname;
-  fname.reserve(appname.size());
-  std::regex re{"^\\./"};
-  std::regex_replace(std::back_inserter(fname), appname.begin(), appname.end(), re, "");
-
-  outfile.open(fmt::format("_{}",fname));
-  outfile << "#compdef " << fname << '\n';
-  outfile << '\n';
-  outfile << "_arguments \\" << '\n';
-  if (!m_args.empty()) {
-    for (std::size_t i = 0 ; i < m_args.size() -1 ; ++i) {
-      outfile << "  \"" << m_args[i]->completion_entry(false) << "\" \\\n";
-    }
-    outfile << "  \"" << m_args.back()->completion_entry(false) << "\"";
-    if (!m_pos.empty() || m_others) {
-      // if there is more to come
-      outfile << " \\";
-    }
-    outfile << "\n";
-  }
-  if (!m_pos.empty()) {
-    for (std::size_t i = 0 ; i < m_pos.size() -1 ; ++i) {
-      outfile << "  \"" << m_pos[i]->completion_entry(true) << "\" \\\n";
-    }
-    outfile << "  \"" << m_pos.back()->completion_entry(true) << "\"";
-    if (m_others) {
-      // if there is more to come
-      outfile << " \\";
+namespace parser_detail {
+TABPARSE_INLINE std::string_view compdef_name(std::string_view appname) {
+  if (appname.substr(0, 2) == "./") {
+    appname.remove_prefix(2);
+  }
+  return appname;
+}
+
+TABPARSE_INLINE void append(fmt::memory_buffer& out, std::string_view text) {
+  out.append(text.data(), text.data() + text.size());
+}
+
+// the tokenizer: every token is classified once by its first characters, the
+// state and the class select what to do with it
+enum class TokenClass : std::uint8_t { Word, DoubleDash, Dashed };
+enum class ReadState : std::uint8_t { Options, Value, Operands };
+enum class Action : std::uint8_t { Operand, Flags, Value, EndOfOptions };
+
+// "-" alone is a word, conventionally for stdin
+TABPARSE_INLINE TokenClass classify(std::string_view token) {
+  if (token.size() < 2 || token[0] != '-') {
+    return TokenClass::Word;
+  }
+  return token == "--" ? TokenClass::DoubleDash : TokenClass::Dashed;
+}
+
+// --name (or --name=value) in option position that names no flag is a
+// mistyped flag, not an operand
+TABPARSE_INLINE bool long_option(std::string_view token) {
+  return token.size() > 2 && token[0] == '-' && token[1] == '-';
+}
+
+// transitions[state][class]
+constexpr Action transitions[3][3] = {
+  /* Options  */ {Action::Operand, Action::EndOfOptions, Action::Flags},
+  /* Value    */ {Action::Value, Action::Value, Action::Value},
+  /* Operands */ {Action::Operand, Action::Operand, Action::Operand},
+};
+
+struct StatsDump {
+  StatsDump() = default;
+  StatsDump(const StatsDump&) = delete;
+  StatsDump& operator=(const StatsDump&) = delete;
+  ~StatsDump() {
+    try {
+      dump_parse_stats();
+    } catch (...) {
+      // statistics are not worth a std::terminate
     }
-    outfile << "\n";
+  }
+};
+}
+
+TABPARSE_INLINE void Parser::render_completion(fmt::memory_buffer& out, std::string_view appname) const {
+  PhaseTimer timer{ParsePhase::Completion};
+  std::size_t size = 64 + appname.size();
+  for (const auto& arg : m_args) {
+    size += arg->completion_size() + 8;
+  }
+  for (const auto& arg : m_pos) {
+    size += arg->completion_size() + 8;
   }
   if (m_others) {
-    outfile << "  \"" << m_others->completion_entry(true) << "\"\n";
+    size += m_others->completion_size() + 8;
+  }
+  out.reserve(out.size() + size);
+
+  fmt::format_to(std::back_inserter(out), "#compdef {}\n\n", parser_detail::compdef_name(appname));
+  if (!m_commands.empty()) {
+    // the functions of the subcommands see words shifted to start at the
+    // subcommand, queries to the program need the whole command line
+    fmt::format_to(std::back_inserter(out), "local -a {0}\n{0}=(\"${{words[@]}}\")\n", query_words_name);
   }
-  outfile.close();
+  render_completion_body(out, fmt::format("_{}", parser_detail::compdef_name(appname)));
 }
 
-void Parser::print_help(std::string_view appname) {
+TABPARSE_INLINE void Parser::render_completion_body(fmt::memory_buffer& out, std::string_view function_name) const {
+  for (const auto& command : m_commands) {
+    // a throwaway parser where the subcommand was not used yet
+    Parser scratch{m_resource};
+    const Parser* sub = command->parser.get();
+    if (!sub) {
+      build_subparser(*command, scratch);
+      sub = &scratch;
+    }
+    auto sub_function = fmt::format("{}_{}", function_name, command->name);
+    fmt::format_to(std::back_inserter(out), "{}() {{\n", sub_function);
+    sub->render_completion_body(out, sub_function);
+    parser_detail::append(out, "}\n\n");
+  }
+  for (const auto& arg : m_args) {
+    arg->completion_helpers(out, m_helper_threshold);
+  }
+  for (const auto& arg : m_pos) {
+    arg->completion_helpers(out, m_helper_threshold);
+  }
+  if (m_others) {
+    m_others->completion_helpers(out, m_helper_threshold);
+  }
+  if (!m_commands.empty()) {
+    parser_detail::append(out, "local curcontext=\"$curcontext\" state line\ntypeset -A opt_args\n_arguments -C");
+  } else {
+    parser_detail::append(out, "_arguments");
+  }
+  // every entry continues the line before it
+  for (const auto& arg : m_args) {
+    parser_detail::append(out, " \\\n  \"");
+    // zsh does not offer the arguments of an exclusion list after this one
+    if (m_constraints->has_groups()) {
+      auto others = m_constraints->conflicts(*arg);
+      if (!others.empty()) {
+        out.push_back('(');
+        for (const ArgBase* other : others) {
+          if (other != others.front()) {
+            out.push_back(' ');
+          }
+          parser_detail::append(out, other->m_name);
+        }
+        out.push_back(')');
+      }
+    }
+    arg->completion_entry(out, false, m_helper_threshold);
+    out.push_back('"');
+  }
+  for (const auto& arg : m_pos) {
+    parser_detail::append(out, " \\\n  \"");
+    arg->completion_entry(out, true, m_helper_threshold);
+    out.push_back('"');
+  }
+  if (m_others) {
+    parser_detail::append(out, " \\\n  \"");
+    m_others->completion_entry(out, true, m_helper_threshold);
+    out.push_back('"');
+  }
+  if (m_commands.empty()) {
+    out.push_back('\n');
+    return;
+  }
+  // the first operand is the subcommand, the words from there on ($line[1]
+  // onwards) go to the function of the subcommand
+  parser_detail::append(out, " \\\n  \"1: :->command\" \\\n  \"*:: :->arguments\"\n"
+                             "case $state in\n"
+                             "  (command)\n"
+                             "    local -a commands\n"
+                             "    commands=(\n");
+  fmt::memory_buffer entry;
+  for (const auto& command : m_commands) {
+    entry.clear();
+    append_candidate(entry, command->name, command->doc);
+    parser_detail::append(out, "      ");
+    append_quoted(out, {entry.data(), entry.size() - 1});
+    out.push_back('\n');
+  }
+  fmt::format_to(std::back_inserter(out),
+                 "    )\n"
+                 "    _describe -t commands command commands\n"
+                 "    ;;\n"
+                 "  (arguments)\n"
+                 "    curcontext=\"${{curcontext%:*:*}}:{1}-$line[1]:\"\n"
+                 "    (( $+functions[{0}_$line[1]] )) && {0}_$line[1]\n"
+                 "    ;;\n"
+                 "esac\n",
+                 function_name, function_name.substr(1));
+}
 
-  auto printlength = [](const auto& arg_unique_ptr) {
-    return arg_unique_ptr->m_name.size() + 1 + arg_unique_ptr->m_shortdoc.size();
-  };
-  auto max_length = printlength(
-      *std::max_element(m_args.begin(), m_args.end(),
-                        [printlength](const auto &a, const auto &b) {
-                          return printlength(a) < printlength(b);
-                        }));
+TABPARSE_INLINE void Parser::print_completion(std::string_view appname) const {
+  print_completion(appname, fmt::format("_{}", parser_detail::compdef_name(appname)));
+}
+
+TABPARSE_INLINE void Parser::print_completion(std::string_view appname, int fd) const {
+  fmt::memory_buffer out;
+  render_completion(out, appname);
+  write_buffer(fd, {out.data(), out.size()});
+}
+
+TABPARSE_INLINE void Parser::print_completion(std::string_view appname, std::string_view path) const {
+  fmt::memory_buffer out;
+  render_completion(out, appname);
+  write_buffer(path, {out.data(), out.size()});
+}
+
+TABPARSE_INLINE bool Parser::completion_request(int argc, const char* const* argv) {
+  return argc > 2 && argv[1] == complete_keyword;
+}
+
+TABPARSE_INLINE bool Parser::generation_request(int argc, const char* const* argv) {
+  return argc == 4 && argv[1] == generate_keyword;
+}
+
+TABPARSE_INLINE bool Parser::update_completion(std::string_view appname, std::string_view path) const {
+  fmt::memory_buffer script;
+  render_completion(script, appname);
+  std::string_view text{script.data(), script.size()};
+  // zsh wants the #compdef line first, the fingerprint follows it
+  auto compdef = text.substr(0, text.find('\n') + 1);
+  auto header = fmt::format("{}# tabparse schema {:016x}\n", compdef, fingerprint(text));
+  if (file_starts_with(path, header)) {
+    return false;
+  }
+  fmt::memory_buffer out;
+  out.reserve(header.size() + text.size());
+  parser_detail::append(out, header);
+  parser_detail::append(out, text.substr(compdef.size()));
+  write_buffer(path, {out.data(), out.size()});
+  return true;
+}
+
+TABPARSE_INLINE void Parser::answer_generation(int /*unused*/, const char* const* argv) const {
+  try {
+    (void)update_completion(argv[2], argv[3]);
+  } catch (const std::exception& e) {
+    fmt::print(stderr, "{}\n", e.what());
+    std::exit(EXIT_FAILURE);
+  }
+  std::exit(EXIT_SUCCESS);
+}
+
+TABPARSE_INLINE void Parser::render_candidates(fmt::memory_buffer& out, ArgIter begin, ArgIter end, std::size_t current) const {
+  PhaseTimer timer{ParsePhase::Completion};
+  std::size_t n_words = std::size_t(end - begin);
+  std::string_view prefix = current < n_words ? begin[std::ptrdiff_t(current)] : std::string_view{};
+  // replay the command line up to the word being completed, as parse reads it
+  auto state = parser_detail::ReadState::Options;
+  const ArgBase* value_for = nullptr;
+  std::size_t n_positional = 0;
+  // the flags given, for the groups that rule out others
+  Constraints::Mask given;
+  for (std::size_t i = 0; i < std::min(current, n_words); ++i) {
+    std::string_view token = begin[std::ptrdiff_t(i)];
+    auto action = parser_detail::transitions[std::size_t(state)][std::size_t(parser_detail::classify(token))];
+    if (action == parser_detail::Action::Value) {
+      value_for = nullptr;
+      state = parser_detail::ReadState::Options;
+      continue;
+    }
+    if (action == parser_detail::Action::EndOfOptions) {
+      state = parser_detail::ReadState::Operands;
+      continue;
+    }
+    if (action == parser_detail::Action::Flags &&
+        read_flags(token, [&](const ArgBase& arg, std::optional<std::string_view> attached) {
+          if (given.size() <= arg.m_slot / 64) {
+            given.resize(arg.m_slot / 64 + 1, 0);
+          }
+          given[arg.m_slot / 64] |= std::uint64_t{1} << (arg.m_slot % 64);
+          if (value_expected(arg) && !attached) {
+            value_for = &arg;
+            state = parser_detail::ReadState::Value;
+          }
+        })) {
+      continue;
+    }
+    if (action == parser_detail::Action::Flags && parser_detail::long_option(token)) {
+      continue;
+    }
+    if (n_positional == 0 && state == parser_detail::ReadState::Options) {
+      if (const Subcommand* command = find_command(token)) {
+        // only the parser of the subcommand on the command line is built
+        Parser scratch{m_resource};
+        const Parser* sub = command->parser.get();
+        if (!sub) {
+          build_subparser(*command, scratch);
+          sub = &scratch;
+        }
+        sub->render_candidates(out, begin + std::ptrdiff_t(i + 1), end, current - i - 1);
+        return;
+      }
+    }
+    ++n_positional;
+  }
+  if (value_for) {
+    value_for->candidates(out, prefix);
+    return;
+  }
+  if (state == parser_detail::ReadState::Operands || prefix.substr(0, 1) != "-") {
+    if (!m_commands.empty() && n_positional == 0) {
+      parser_detail::append(out, "describe command\n");
+      for (const auto& command : m_commands) {
+        if (std::string_view{command->name}.substr(0, prefix.size()) == prefix) {
+          append_candidate(out, command->name, command->doc);
+        }
+      }
+      return;
+    }
+    if (n_positional < m_pos.size()) {
+      m_pos[n_positional]->candidates(out, prefix);
+      return;
+    }
+    if (m_others) {
+      m_others->candidates(out, prefix);
+      return;
+    }
+  }
+  Constraints::Mask excluded;
+  m_constraints->excluded(given, excluded);
+  parser_detail::append(out, "describe option\n");
+  for (const auto& arg : m_args) {
+    auto slot = arg->m_slot;
+    if (slot / 64 < excluded.size() && (excluded[slot / 64] >> (slot % 64)) & 1u) {
+      continue;
+    }
+    if (std::string_view{arg->m_name}.substr(0, prefix.size()) == prefix) {
+      append_candidate(out, arg->m_name, arg->m_doc);
+    }
+  }
+}
+
+TABPARSE_INLINE void Parser::answer_completion(int argc, const char* const* argv) const {
+  // zsh counts words from 1, and words[1] is the program itself
+  auto current = parse_number<std::size_t>(argv[2]);
+  fmt::memory_buffer out;
+  if (argc > 3 && current >= 2) {
+    render_candidates(out, ArgIter{argv + 4}, ArgIter{argv + argc}, current - 2);
+  }
+  write_buffer(STDOUT_FILENO, {out.data(), out.size()});
+  dump_parse_stats();
+  std::exit(EXIT_SUCCESS);
+}
+
+TABPARSE_INLINE void Parser::render_dynamic_completion(fmt::memory_buffer& out, std::string_view appname) const {
+  auto name = parser_detail::compdef_name(appname);
+  fmt::format_to(std::back_inserter(out), "#compdef {}\n\n", name);
+  append_dynamic_query(out, "");
+}
+
+TABPARSE_INLINE void Parser::print_dynamic_completion(std::string_view appname) const {
+  fmt::memory_buffer out;
+  render_dynamic_completion(out, appname);
+  write_buffer(fmt::format("_{}", parser_detail::compdef_name(appname)), {out.data(), out.size()});
+}
+
+TABPARSE_INLINE const ArgBase* Parser::find_flag(std::string_view token) const {
+  PhaseTimer timer{ParsePhase::Lookup};
+  auto found = m_index.find(token);
+  if (found != m_index.end()) {
+    return found->second;
+  }
+  if (m_abbreviations && token.size() > 2 && token.substr(0, 2) == "--") {
+    auto idx = m_trie.complete(token);
+    if (idx != FlagTrie::npos) {
+      return m_args[idx].get();
+    }
+  }
+  return nullptr;
+}
+
+TABPARSE_INLINE const Parser::Subcommand* Parser::find_command(std::string_view token) const {
+  auto found = m_command_index.find(token);
+  return found == m_command_index.end() ? nullptr : m_commands[found->second].get();
+}
+
+TABPARSE_INLINE void Parser::addSubcommand(std::string_view name, std::string_view doc, std::function<void(Parser&)> factory) {
+  if (!m_pos.empty() || m_others) {
+    throw std::invalid_argument("a parser with positional arguments can not have subcommands.");
+  }
+  if (find_command(name)) {
+    throw std::invalid_argument(fmt::format("subcommand {} already exists", name));
+  }
+  if (name.empty() || name[0] == '-') {
+    throw std::invalid_argument(fmt::format("subcommands can not start with -. {} does.", name));
+  }
+  m_commands.push_back(std::make_unique<Subcommand>(Subcommand{std::string{name}, std::string{doc}, std::move(factory), nullptr}));
+  m_command_index.emplace(m_commands.back()->name, m_commands.size() - 1);
+  m_command_width = std::max(m_command_width, name.size());
+  m_help_size += name.size() + doc.size() + 8;
+}
+
+TABPARSE_INLINE void Parser::build_subparser(const Subcommand& command, Parser& sub) const {
+  sub.m_nested = true;
+  sub.m_abbreviations = m_abbreviations;
+  sub.m_helper_threshold = m_helper_threshold;
+  command.factory(sub);
+}
+
+TABPARSE_INLINE void Parser::addGroup(GroupKind kind, std::initializer_list<const ArgBase*> members) {
+  m_constraints->add_group(kind, members);
+}
+
+TABPARSE_INLINE void Parser::addDependency(const ArgBase* arg, std::initializer_list<const ArgBase*> needed) {
+  if (!arg) {
+    throw std::invalid_argument("constraints can only refer to arguments of the same parser.");
+  }
+  m_constraints->add_dependency(*arg, needed);
+}
+
+TABPARSE_INLINE Parser& Parser::subparser(std::string_view name) {
+  auto found = m_command_index.find(name);
+  if (found == m_command_index.end()) {
+    throw std::invalid_argument(fmt::format("no subcommand {}.", name));
+  }
+  auto& command = *m_commands[found->second];
+  if (!command.parser) {
+    auto sub = std::make_unique<Parser>(m_resource);
+    build_subparser(command, *sub);
+    command.parser = std::move(sub);
+  }
+  return *command.parser;
+}
+
+TABPARSE_INLINE const ArgBase* Parser::short_flag(char c) const {
+  const char name[2] = {'-', c};
+  auto found = m_index.find(std::string_view{name, 2});
+  return found == m_index.end() ? nullptr : found->second;
+}
+
+template <typename ON_FLAG>
+bool Parser::read_flags(std::string_view token, ON_FLAG&& on_flag) const {
+  if (const ArgBase* arg = find_flag(token)) {
+    on_flag(*arg, std::nullopt);
+    return true;
+  }
+  if (token[1] == '-') {
+    auto equals = token.find('=');
+    const ArgBase* arg = equals == std::string_view::npos ? nullptr : find_flag(token.substr(0, equals));
+    if (!arg) {
+      return false;
+    }
+    on_flag(*arg, token.substr(equals + 1));
+    return true;
+  }
+  // all characters up to end name flags, the one before end may take the
+  // rest of the token as its value. Nothing is handed out unless all do.
+  std::size_t end = 1;
+  while (end < token.size()) {
+    const ArgBase* arg = short_flag(token[end++]);
+    if (!arg) {
+      return false;
+    }
+    if (value_expected(*arg)) {
+      break;
+    }
+  }
+  for (std::size_t i = 1; i < end; ++i) {
+    const ArgBase* arg = short_flag(token[i]);
+    if (i + 1 == end && value_expected(*arg) && end < token.size()) {
+      on_flag(*arg, token.substr(end));
+    } else {
+      on_flag(*arg, std::nullopt);
+    }
+  }
+  return true;
+}
 
-  std::cout << "USAGE: " << appname;
+TABPARSE_INLINE std::string Parser::suggestion(std::string_view token) const {
+  if (token.substr(0, 1) != "-") {
+    return {};
+  }
+  // one typo in short names, two (a swapped pair) in longer ones
+  auto idx = m_trie.closest(token, token.size() < 6 ? 1 : 2);
+  if (idx == FlagTrie::npos) {
+    return {};
+  }
+  return fmt::format(" Did you mean {}?", m_args[idx]->m_name);
+}
+
+TABPARSE_INLINE void Parser::add_help_entry(const ArgBase& arg) {
+  auto printlength = arg.m_name.size() + 1 + arg.m_shortdoc.size();
+  m_help_width = std::max(m_help_width, printlength);
+  m_help_size += arg.m_doc.size() + arg.m_name.size() + 8;
+}
+
+TABPARSE_INLINE void Parser::render_help(fmt::memory_buffer& out, std::string_view appname, std::size_t width) const {
+  PhaseTimer timer{ParsePhase::Help};
+  out.reserve(out.size() + m_help_size + m_args.size() * (m_help_width + 8) + 64 * (m_pos.size() + 1));
+  auto outiter = std::back_inserter(out);
+
+  fmt::format_to(outiter, "USAGE: {}", appname);
   for (const auto& arg: m_args) {
     if (arg->m_flags.test(ArgFlags::Required)) {
-      fmt::print(" {} {}", arg->m_name, arg->m_shortdoc);
+      fmt::format_to(outiter, " {} {}", arg->m_name, arg->m_shortdoc);
     }
   }
   for (const auto& pos: m_pos) {
     if (pos->m_flags.test(ArgFlags::Required)) {
-      fmt::print(" {}", pos->m_shortdoc);
+      fmt::format_to(outiter, " {}", pos->m_shortdoc);
     } else {
-      fmt::print(" [{}]", pos->m_shortdoc);
+      fmt::format_to(outiter, " [{}]", pos->m_shortdoc);
     }
   }
-  std::cout << '\n';
-  std::cout << '\n';
+  if (!m_commands.empty()) {
+    parser_detail::append(out, " COMMAND [ARGS]");
+  }
+  parser_detail::append(out, "\n\n");
+  // the doc column is the same for all flags
+  std::size_t doc_column = m_help_width + 5;
   for (const auto& arg: m_args) {
-    fmt::print("  {} {:<{}}{}\n", arg->m_name, arg->m_shortdoc, max_length + 2 - arg->m_name.size(), arg->m_doc);
+    fmt::format_to(outiter, "  {} {:<{}}", arg->m_name, arg->m_shortdoc, m_help_width + 2 - arg->m_name.size());
+    append_wrapped(out, arg->m_doc, doc_column, width);
+    out.push_back('\n');
   }
+  if (m_commands.empty()) {
+    return;
+  }
+  parser_detail::append(out, "\nCOMMANDS:\n");
+  for (const auto& command : m_commands) {
+    fmt::format_to(outiter, "  {:<{}}", command->name, m_command_width + 3);
+    append_wrapped(out, command->doc, m_command_width + 5, width);
+    out.push_back('\n');
+  }
+}
+
+TABPARSE_INLINE void Parser::print_help(std::string_view appname) const {
+  print_help(appname, STDOUT_FILENO);
+}
+
+TABPARSE_INLINE void Parser::print_help(std::string_view appname, int fd) const {
+  fmt::memory_buffer out;
+  render_help(out, appname, terminal_width(fd));
+  write_buffer(fd, {out.data(), out.size()});
+}
+
+TABPARSE_INLINE void Parser::print_help(std::string_view appname, std::string_view path) const {
+  fmt::memory_buffer out;
+  render_help(out, appname, 0);
+  write_buffer(path, {out.data(), out.size()});
 }
 
-void Parser::sanitize() {
+TABPARSE_INLINE void Parser::sanitize() {
+  PhaseTimer timer{ParsePhase::Sanitize};
   std::size_t i = m_pos.size();
   for (; i > 0 ; i--) {
     if (m_pos[i-1]->m_flags.test(ArgFlags::Required)) {
@@ -128,88 +546,394 @@ void Parser::sanitize() {
   }
 }
 
-void Parser::parse(int argc, char *argv[]) {
+TABPARSE_INLINE void Parser::parse(int argc, char *argv[]) {
+  if (completion_request(argc, argv)) {
+    answer_completion(argc, argv);
+  }
+  if (generation_request(argc, argv)) {
+    answer_generation(argc, argv);
+  }
+  // also when parsing throws
+  parser_detail::StatsDump dump;
   sanitize();
-  std::vector<std::string> inargs(argv + 1, argv + argc);
-  auto findres = std::find(inargs.begin(), inargs.end(), "--help");
-  if (findres != inargs.end()) {
-    print_help(argv[0]);
+  // no copy of argv, all args get views into it (or into the response files
+  // kept mapped by m_result)
+  auto& result = m_result;
+  parse(argc, argv, result);
+  apply(result, argv[0]);
+}
+
+TABPARSE_INLINE void Parser::apply(const ParseResult& result, std::string_view appname) {
+  m_selected = nullptr;
+  if (result.help_requested()) {
+    print_help(appname);
+    return;
+  }
+  if (result.completion_requested()) {
+    print_completion(appname);
     return;
   }
-  findres = std::find(inargs.begin(), inargs.end(), "complete");
-  if (findres != inargs.end()) {
-    print_completion(argv[0]);
+  for (const auto& arg : m_args) {
+    arg->assign(result.tokens(arg.get()));
+  }
+  for (const auto& arg : m_pos) {
+    arg->assign(result.tokens(arg.get()));
+  }
+  if (m_others) {
+    m_others->assign(result.tokens(m_others.get()));
+  }
+  // read stat'ed the paths already
+  for (ArgBase* arg : m_stored_checks) {
+    arg->take_stored(result.paths(arg));
+  }
+  if (result.subcommand().empty()) {
     return;
   }
-  auto posarg_iter = m_pos.begin();
-  for (auto iter = inargs.begin();
-      iter != inargs.end();
-      /* increment in parse method */) {
-    auto matchingarg = std::find_if(m_args.begin(), m_args.end(), [iter](const auto& arg) { return *iter == arg->m_name; });
-    if (matchingarg != m_args.end()) {
-      iter = (*matchingarg)->parse(++iter);
+  Parser& sub = subparser(result.subcommand());
+  m_selected = find_command(result.subcommand());
+  sub.sanitize();
+  sub.parse(result.subcommand_begin(), result.subcommand_end(), sub.m_result);
+  sub.apply(sub.m_result, fmt::format("{} {}", appname, result.subcommand()));
+}
+
+TABPARSE_INLINE void Parser::parse(int argc, const char* const* argv, ParseResult& result) const {
+  {
+    PhaseTimer timer{ParsePhase::ArgvCopy};
+    result.m_argv.expand(argc - 1, argv + 1);
+  }
+  parse(result.m_argv.begin(), result.m_argv.end(), result);
+}
+
+TABPARSE_INLINE void Parser::apply_fallbacks(ParseResult& result) const {
+  PhaseTimer timer{ParsePhase::Fallback};
+  auto& diagnostics = result.m_diagnostics;
+  auto store = [&](const ArgBase& arg, std::string_view value, DiagnosticSource source) {
+    if (!value_expected(arg)) {
+      // a switch is on or off
+      if (value == "1" || value == "true" || value == "yes" || value == "on") {
+        result.store(arg, arg.m_name);
+      } else if (!(value.empty() || value == "0" || value == "false" || value == "no" || value == "off")) {
+        diagnostics.push_back({DiagnosticKind::InvalidValue, source, &arg, value});
+      }
+      return;
+    }
+    std::optional<DiagnosticKind> problem;
+    {
+      PhaseTimer conversion_timer{ParsePhase::Conversion};
+      problem = validate_value(arg, value);
+    }
+    if (problem) {
+      diagnostics.push_back({*problem, source, &arg, value});
     } else {
-      if (m_pos.empty() && !m_others) {
-        throw std::invalid_argument(fmt::format("did not identify {} as option and did not expect positional arguments.", *iter));
+      result.store(arg, value);
+    }
+  };
+  auto validate_stored = [&](const ArgBase& arg, DiagnosticSource source) {
+    if (result.present(&arg)) {
+      PhaseTimer conversion_timer{ParsePhase::Conversion};
+      std::vector<PathInfo> infos;
+      arg.validate_stored(result.tokens(&arg), source, diagnostics, infos);
+      result.store_paths(arg, std::move(infos));
+    }
+  };
+  auto fall_back = [&](const ArgBase& arg) {
+    // a bad value on the command line does not fall back either
+    if (result.present(&arg) || std::any_of(diagnostics.begin(), diagnostics.end(), [&arg](const Diagnostic& d) { return d.arg == &arg; })) {
+      return;
+    }
+    if (!arg.m_env.empty()) {
+      if (const char* value = std::getenv(arg.m_env.c_str())) {
+        store(arg, value, DiagnosticSource::Environment);
+        validate_stored(arg, DiagnosticSource::Environment);
+        return;
       }
-      if (posarg_iter != m_pos.end()) {
-        (*posarg_iter)->parse(iter++);
-        posarg_iter++;
+    }
+    if (arg.m_config_key.empty() || m_config_path.empty()) {
+      return;
+    }
+    if (!result.m_config) {
+      result.m_config.emplace(m_config_path);
+      if (!result.m_config->error().empty()) {
+        diagnostics.push_back({DiagnosticKind::UnreadableConfig, DiagnosticSource::ConfigFile, nullptr, result.m_config->error()});
+      }
+    }
+    if (const auto* values = result.m_config->values(arg.m_config_key)) {
+      for (auto value : *values) {
+        store(arg, value, DiagnosticSource::ConfigFile);
+      }
+      validate_stored(arg, DiagnosticSource::ConfigFile);
+    }
+  };
+  for (const auto& arg : m_args) {
+    fall_back(*arg);
+  }
+  for (const auto& arg : m_pos) {
+    fall_back(*arg);
+  }
+  if (m_others) {
+    fall_back(*m_others);
+  }
+  if (result.m_config && !result.m_config->malformed_line().empty()) {
+    diagnostics.push_back({DiagnosticKind::MalformedConfig, DiagnosticSource::ConfigFile, nullptr, result.m_config->malformed_line()});
+  }
+}
+
+TABPARSE_INLINE void Parser::stream_others(const std::string& path, std::size_t chunk_size,
+                           const std::function<void(const std::vector<std::string_view>&)>& on_chunk) const {
+  if (!m_others) {
+    throw std::invalid_argument("streaming a response file requires an argument added with addOther.");
+  }
+  stream_response_file(path, chunk_size, [this, &on_chunk](const std::vector<std::string_view>& chunk) {
+    for (auto token : chunk) {
+      m_others->check(token);
+    }
+    on_chunk(chunk);
+  });
+}
+
+TABPARSE_INLINE void Parser::parse(ArgIter begin, ArgIter end, ParseResult& result) const {
+  read(begin, end, result);
+  if (!result.m_diagnostics.empty()) {
+    throw std::invalid_argument(describe(result.m_diagnostics.front()));
+  }
+}
+
+TABPARSE_INLINE bool Parser::try_parse(ArgIter begin, ArgIter end, ParseResult& result) const {
+  read(begin, end, result);
+  return result.m_diagnostics.empty();
+}
+
+TABPARSE_INLINE bool Parser::try_parse(int argc, const char* const* argv, ParseResult& result) const {
+  {
+    PhaseTimer timer{ParsePhase::ArgvCopy};
+    result.m_argv.expand(argc - 1, argv + 1);
+  }
+  return try_parse(result.m_argv.begin(), result.m_argv.end(), result);
+}
+
+TABPARSE_INLINE std::string Parser::describe(const Diagnostic& diagnostic) const {
+  const ArgBase* arg = diagnostic.arg;
+  auto token = diagnostic.token;
+  std::string message;
+  switch (diagnostic.kind) {
+    case DiagnosticKind::NotANumber:
+      message = fmt::format("could not parse {} as number.", token);
+      break;
+    case DiagnosticKind::OutOfRange:
+      message = fmt::format("{} is out of range.", token);
+      break;
+    case DiagnosticKind::DescendingRange: {
+      auto range = descending_range(token);
+      message = fmt::format("{}: range {} is descending.", token, range.empty() ? token : range);
+      break;
+    }
+    case DiagnosticKind::FloatRange:
+      message = fmt::format("{}: ranges are only supported for integers.", token);
+      break;
+    case DiagnosticKind::ListTooLong:
+      message = fmt::format("{}: stands for more than {} numbers.", token, max_list_values);
+      break;
+    case DiagnosticKind::InvalidChoice:
+      message = fmt::format("{} is not a valid choice for {}.", token, arg->m_name);
+      break;
+    case DiagnosticKind::PatternMismatch:
+      message = fmt::format("{} does not match the pattern of {}.", token, arg->m_name);
+      break;
+    case DiagnosticKind::MissingPath:
+      message = fmt::format("{} does not exist.", token);
+      break;
+    case DiagnosticKind::NotAFile:
+      message = fmt::format("{} is a directory.", token);
+      break;
+    case DiagnosticKind::NotADirectory:
+      message = fmt::format("{} is not a directory.", token);
+      break;
+    case DiagnosticKind::UnreadablePath:
+      message = fmt::format("can not stat {}.", token);
+      break;
+    case DiagnosticKind::InvalidValue:
+      message = fmt::format("{} is not a valid value for {}.", token, arg->m_name);
+      break;
+    case DiagnosticKind::UnexpectedValue:
+      message = fmt::format("{} does not take a value.", arg->m_name);
+      break;
+    case DiagnosticKind::MissingValue:
+      message = fmt::format("missing value for {}.", arg->m_name);
+      break;
+    case DiagnosticKind::UnexpectedArgument:
+      if (m_pos.empty() && !m_others) {
+        message = fmt::format("did not identify {} as option and did not expect positional arguments.{}", token, suggestion(token));
       } else {
-        if (m_others) {
-          // TODO: can not interleave any m_args after this point :(
-          iter = m_others->parse(iter, inargs.end());
+        message = fmt::format("no more positional arguments expected, received {}.{}", token, suggestion(token));
+      }
+      break;
+    case DiagnosticKind::UnknownFlag:
+      message = fmt::format("unknown option {}.{}", token, suggestion(token.substr(0, token.find('='))));
+      break;
+    case DiagnosticKind::UnknownCommand:
+      message = fmt::format("unknown command {}.", token);
+      break;
+    case DiagnosticKind::MissingRequired:
+      message = fmt::format("required argument {} not used.", arg->label());
+      break;
+    case DiagnosticKind::MalformedConfig:
+      return fmt::format("{}: expected key = value, got {}.", m_config_path, token);
+    case DiagnosticKind::UnreadableConfig:
+      return fmt::format("could not read config file {}: {}.", m_config_path, token);
+    case DiagnosticKind::Conflict:
+      message = fmt::format("{} can not be used together with {}.", arg->label(), token);
+      break;
+    case DiagnosticKind::MissingOneOf:
+      message = fmt::format("one of {} is required.", token);
+      break;
+    case DiagnosticKind::MissingDependency:
+      message = fmt::format("{} requires {}.", arg->label(), token);
+      break;
+  }
+  if (diagnostic.source == DiagnosticSource::Environment) {
+    message += fmt::format(" (environment variable {})", arg->m_env);
+  } else if (diagnostic.source == DiagnosticSource::ConfigFile) {
+    message += fmt::format(" ({} in {})", arg->m_config_key, m_config_path);
+  }
+  return message;
+}
+
+TABPARSE_INLINE void Parser::read(ArgIter begin, ArgIter end, ParseResult& result) const {
+  PhaseTimer parse_timer{ParsePhase::Parse};
+  using parser_detail::Action;
+  using parser_detail::ReadState;
+  result.reset(m_slots);
+  auto& diagnostics = result.m_diagnostics;
+  const ArgBase* help = m_args.front().get();
+  auto state = ReadState::Options;
+  // the flag the next token is the value of
+  const ArgBase* pending = nullptr;
+  std::size_t n_operands = 0;
+  auto store_checked = [&result, &diagnostics](const ArgBase& arg, std::string_view value) {
+    std::optional<DiagnosticKind> problem;
+    {
+      PhaseTimer timer{ParsePhase::Conversion};
+      problem = validate_value(arg, value);
+    }
+    if (problem) {
+      diagnostics.push_back({*problem, DiagnosticSource::CommandLine, &arg, value});
+    } else {
+      result.store(arg, value);
+    }
+  };
+  auto unexpected = [&diagnostics](DiagnosticKind kind, std::string_view token) {
+    diagnostics.push_back({kind, DiagnosticSource::CommandLine, nullptr, token});
+  };
+  for (auto iter = begin; iter != end; ++iter) {
+    std::string_view token = *iter;
+    auto action = parser_detail::transitions[std::size_t(state)][std::size_t(parser_detail::classify(token))];
+    if (action == Action::Value) {
+      store_checked(*pending, token);
+      pending = nullptr;
+      state = ReadState::Options;
+      continue;
+    }
+    if (action == Action::EndOfOptions) {
+      state = ReadState::Operands;
+      continue;
+    }
+    if (action == Action::Flags) {
+      bool named_flags = read_flags(token, [&](const ArgBase& arg, std::optional<std::string_view> attached) {
+        if (&arg == help) {
+          result.m_help = true;
+        } else if (!value_expected(arg)) {
+          if (attached) {
+            diagnostics.push_back({DiagnosticKind::UnexpectedValue, DiagnosticSource::CommandLine, &arg, token});
+          } else {
+            result.store(arg, token);
+          }
+        } else if (attached) {
+          store_checked(arg, *attached);
         } else {
-          throw std::invalid_argument(fmt::format("no more positional arguments expected, received {}.", *iter));
+          pending = &arg;
+          state = ReadState::Value;
         }
+      });
+      if (result.m_help) {
+        // wins over any error
+        diagnostics.clear();
+        return;
+      }
+      if (named_flags) {
+        continue;
+      }
+      if (parser_detail::long_option(token)) {
+        unexpected(DiagnosticKind::UnknownFlag, token);
+        continue;
       }
     }
-  }
-  for (const auto& arg : m_args) {
-    if (!arg->m_flags.test(ArgFlags::Present)) {
-      if (arg->m_flags.test(ArgFlags::Required)) {
-        throw std::invalid_argument(fmt::format("required argument {} not used.", arg->m_name));
+    // an operand: subcommand, positional argument or overflow
+    if (state == ReadState::Options && n_operands == 0) {
+      if (find_command(token)) {
+        // the rest of the command line belongs to the subcommand
+        result.m_command = token;
+        result.m_command_begin = iter + 1;
+        result.m_command_end = end;
+        break;
       }
+      if (token == "complete" && !m_nested) {
+        result.m_complete = true;
+        diagnostics.clear();
+        return;
+      }
+    }
+    if (!m_commands.empty()) {
+      // the rest is meant for a command that does not exist
+      unexpected(DiagnosticKind::UnknownCommand, token);
+      break;
+    }
+    if (n_operands < m_pos.size()) {
+      store_checked(*m_pos[n_operands++], token);
+      continue;
     }
+    if (!m_others) {
+      unexpected(DiagnosticKind::UnexpectedArgument, token);
+      continue;
+    }
+    // the run of operands up to the next token that may be a flag is
+    // checked and stored in one go
+    auto run_end = iter + 1;
+    while (run_end != end && (state == ReadState::Operands || parser_detail::classify(*run_end) == parser_detail::TokenClass::Word)) {
+      ++run_end;
+    }
+    std::size_t n_problems = diagnostics.size();
+    {
+      PhaseTimer timer{ParsePhase::Conversion};
+      m_others->validate_all(iter, run_end, diagnostics);
+    }
+    if (diagnostics.size() == n_problems) {
+      result.store_all(*m_others, iter, run_end);
+    } else {
+      // only the good ones
+      for (auto good = iter; good != run_end; ++good) {
+        if (!m_others->validate(*good)) {
+          result.store(*m_others, *good);
+        }
+      }
+    }
+    n_operands += std::size_t(run_end - iter);
+    iter = run_end - 1;
   }
-  for (const auto& arg : m_pos) {
-    if (!arg->m_flags.test(ArgFlags::Present)) {
-      if (arg->m_flags.test(ArgFlags::Required)) {
-        throw std::invalid_argument(fmt::format("required argument {} not used.", arg->m_shortdoc));
+  if (pending) {
+    diagnostics.push_back({DiagnosticKind::MissingValue, DiagnosticSource::CommandLine, pending, {}});
+  }
+  {
+    PhaseTimer timer{ParsePhase::Conversion};
+    for (const ArgBase* arg : m_stored_checks) {
+      if (result.present(arg)) {
+        std::vector<PathInfo> infos;
+        arg->validate_stored(result.tokens(arg), DiagnosticSource::CommandLine, diagnostics, infos);
+        result.store_paths(*arg, std::move(infos));
       }
     }
   }
-
+  apply_fallbacks(result);
+  PhaseTimer required_timer{ParsePhase::Required};
+  // a missing value was reported already
+  m_constraints->check(result.m_present, pending, diagnostics);
 }
-
-template DirectoryArg* Parser::addArg<DirectoryArg>(std::string_view, std::string, std::string_view, std::string_view);
-template FileArg* Parser::addArg<FileArg>(std::string_view, std::string, std::string_view, std::string_view, std::string_view);
-template StringArg* Parser::addArg<StringArg>(std::string_view, std::string, std::string_view, std::string_view);
-template IntArg* Parser::addArg<IntArg>(std::string_view, int, std::string_view, std::string_view);
-template SwitchArg* Parser::addArg<SwitchArg>(std::string_view, bool, std::string_view, std::string_view);
-template StringChoiceArg* Parser::addArg<StringChoiceArg>(std::string_view, std::string, std::string_view, std::string_view, std::initializer_list<std::string>);
-template StringChoiceArg* Parser::addArg<StringChoiceArg>(std::string_view, std::string, std::string_view, std::string_view, std::initializer_list<std::string>, std::initializer_list<std::string>);
-
-template DirectoryArg* Parser::addPosArg<DirectoryArg>(std::string, std::string_view, std::string_view);
-template FileArg* Parser::addPosArg<FileArg>(std::string, std::string_view, std::string_view, std::string_view);
-template StringArg* Parser::addPosArg<StringArg>(std::string, std::string_view, std::string_view);
-template IntArg* Parser::addPosArg<IntArg>(int, std::string_view, std::string_view);
-// template bool& Parser::addPosArg<SwitchArg>(bool, std::string_view, std::string_view);
-template StringChoiceArg* Parser::addPosArg<StringChoiceArg>(std::string, std::string_view, std::string_view, std::initializer_list<std::string>);
-template StringChoiceArg* Parser::addPosArg<StringChoiceArg>(std::string, std::string_view, std::string_view, std::initializer_list<std::string>, std::initializer_list<std::string>);
-
-template MultiArg<DirectoryArg>* Parser::addOther<DirectoryArg>(std::string_view shortdoc, std::string_view doc);
-template MultiArg<FileArg>* Parser::addOther<FileArg>(std::string_view shortdoc, std::string_view doc, std::string_view pattern);
-template MultiArg<StringArg>* Parser::addOther<StringArg>(std::string_view shortdoc, std::string_view doc);
-template MultiArg<IntArg>* Parser::addOther<IntArg>(std::string_view shortdoc, std::string_view doc);
-// template MultiArg<SwitchArg>* Parser::addOther<SwitchArg>(std::string_view shortdoc, std::string_view doc);
-template MultiArg<StringChoiceArg>* Parser::addOther<StringChoiceArg>(std::string_view shortdoc, std::string_view doc, std::initializer_list<std::string>);
-template MultiArg<StringChoiceArg>* Parser::addOther<StringChoiceArg>(std::string_view shortdoc, std::string_view doc, std::initializer_list<std::string>, std::initializer_list<std::string>);
-
-template VectorArg<DirectoryArg>* Parser::addArg<VectorArg<DirectoryArg>>(std::string_view, std::string, std::string_view, std::string_view);
-template VectorArg<FileArg>* Parser::addArg<VectorArg<FileArg>>(std::string_view, std::string, std::string_view, std::string_view, std::string_view);
-template VectorArg<StringArg>* Parser::addArg<VectorArg<StringArg>>(std::string_view, std::string, std::string_view, std::string_view);
-template VectorArg<IntArg>* Parser::addArg<VectorArg<IntArg>>(std::string_view, int, std::string_view, std::string_view);
-// template VectorArg<SwitchArg>* Parser::addArg<VectorArg<SwitchArg>>(std::string_view, bool, std::string_view, std::string_view);
-template VectorArg<StringChoiceArg>* Parser::addArg<VectorArg<StringChoiceArg>>(std::string_view, std::string, std::string_view, std::string_view, std::initializer_list<std::string>);
-template VectorArg<StringChoiceArg>* Parser::addArg<VectorArg<StringChoiceArg>>(std::string_view, std::string, std::string_view, std::string_view, std::initializer_list<std::string>, std::initializer_list<std::string>);
@@ -0,0 +1,252 @@
+#include "path_check.h"
+#include "header_only.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <stdexcept>
+#include <system_error>
+#include <thread>
+#include <fmt/format.h>
+
+namespace path_check_detail {
+// paths a thread claims at once
+inline constexpr std::size_t chunk_size = 256;
+
+// the patterns without alternatives that pattern stands for
+TABPARSE_INLINE void expand(std::string_view pattern, std::string prefix, std::vector<std::string>& out) {
+  auto open = pattern.find('(');
+  if (open == std::string_view::npos) {
+    out.push_back(prefix.append(pattern));
+    return;
+  }
+  // split the group at the |s of its own level
+  std::vector<std::string_view> alternatives;
+  std::size_t depth = 0;
+  std::size_t start = open + 1;
+  std::size_t close = open + 1;
+  for (; close < pattern.size(); ++close) {
+    char c = pattern[close];
+    if (c == '(') {
+      ++depth;
+    } else if (c == ')' && depth > 0) {
+      --depth;
+    } else if ((c == '|' || c == ')') && depth == 0) {
+      alternatives.push_back(pattern.substr(start, close - start));
+      start = close + 1;
+      if (c == ')') {
+        break;
+      }
+    }
+  }
+  if (close == pattern.size()) {
+    // unbalanced, the parenthesis is an ordinary character
+    prefix.append(pattern.substr(0, open + 1));
+    expand(pattern.substr(open + 1), std::move(prefix), out);
+    return;
+  }
+  prefix.append(pattern.substr(0, open));
+  for (auto alternative : alternatives) {
+    std::vector<std::string> inner;
+    expand(alternative, {}, inner);
+    for (const auto& choice : inner) {
+      expand(pattern.substr(close + 1), prefix + choice, out);
+    }
+  }
+}
+
+TABPARSE_INLINE int check_status(const struct stat& status, PathKind kind) {
+  bool directory = S_ISDIR(status.st_mode);
+  if ((kind == PathKind::Directory && !directory) || (kind == PathKind::File && directory)) {
+    return path_wrong_kind;
+  }
+  return 0;
+}
+
+TABPARSE_INLINE void stat_range(const std::string_view* paths, PathInfo* infos, int* errors, std::size_t first,
+                                std::size_t last, PathKind kind) {
+  std::string path;
+  for (std::size_t i = first; i < last; ++i) {
+    // the tokens are views, stat wants a terminated string
+    path.assign(paths[i]);
+    infos[i].path = paths[i];
+    errors[i] = ::stat(path.c_str(), &infos[i].status) == 0 ? check_status(infos[i].status, kind) : errno;
+  }
+}
+}
+
+TABPARSE_INLINE GlobPattern::GlobPattern(std::string_view pattern) : m_whole_path{pattern.find('/') != std::string_view::npos} {
+  std::vector<std::string> expanded;
+  path_check_detail::expand(pattern, {}, expanded);
+  m_alternatives.reserve(expanded.size());
+  for (std::string_view text : expanded) {
+    Sequence ops;
+    for (std::size_t i = 0; i < text.size(); ++i) {
+      char c = text[i];
+      if (c == '*') {
+        if (ops.empty() || ops.back().kind != Op::Star) {
+          ops.push_back({Op::Star, {}, {}});
+        }
+        continue;
+      }
+      if (c == '?') {
+        ops.push_back({Op::Any, {}, {}});
+        continue;
+      }
+      if (c == '[') {
+        // a ] right after [ or [! belongs to the set
+        std::size_t j = i + 1;
+        bool negate = j < text.size() && (text[j] == '!' || text[j] == '^');
+        if (negate) {
+          ++j;
+        }
+        std::size_t close = text.find(']', j + 1);
+        if (close != std::string_view::npos) {
+          Op op{Op::Class, {}, {}};
+          for (std::size_t k = j; k < close; ++k) {
+            auto low = static_cast<unsigned char>(text[k]);
+            auto high = low;
+            if (k + 2 < close && text[k + 1] == '-') {
+              high = static_cast<unsigned char>(text[k + 2]);
+              k += 2;
+            }
+            for (unsigned member = low; member <= high; ++member) {
+              op.set.set(member);
+            }
+          }
+          if (negate) {
+            op.set.flip();
+          }
+          ops.push_back(std::move(op));
+          i = close;
+          continue;
+        }
+      }
+      if (c == '\\' && i + 1 < text.size()) {
+        c = text[++i];
+      }
+      if (ops.empty() || ops.back().kind != Op::Literal) {
+        ops.push_back({Op::Literal, {}, {}});
+      }
+      ops.back().literal.push_back(c);
+    }
+    m_alternatives.push_back(std::move(ops));
+  }
+}
+
+TABPARSE_INLINE bool GlobPattern::matches(const Sequence& ops, std::string_view text) {
+  // on a mismatch the last * takes one more character, earlier ones never
+  // need to, each op matches a fixed number of characters
+  constexpr std::size_t none = std::size_t(-1);
+  std::size_t star_op = none;
+  std::size_t star_pos = 0;
+  std::size_t i = 0;
+  std::size_t pos = 0;
+  for (;;) {
+    if (i < ops.size()) {
+      const Op& op = ops[i];
+      if (op.kind == Op::Star) {
+        star_op = i++;
+        star_pos = pos;
+        continue;
+      }
+      std::size_t width = op.kind == Op::Literal ? op.literal.size() : 1;
+      bool match = false;
+      if (op.kind == Op::Literal) {
+        match = text.substr(pos, width) == op.literal;
+      } else if (pos < text.size()) {
+        match = op.kind == Op::Any || op.set.test(static_cast<unsigned char>(text[pos]));
+      }
+      if (match) {
+        pos += width;
+        ++i;
+        continue;
+      }
+    } else if (pos == text.size()) {
+      return true;
+    }
+    if (star_op == none || star_pos >= text.size()) {
+      return false;
+    }
+    pos = ++star_pos;
+    i = star_op + 1;
+  }
+}
+
+TABPARSE_INLINE bool GlobPattern::matches(std::string_view path) const {
+  if (!m_whole_path) {
+    auto slash = path.find_last_of('/');
+    if (slash != std::string_view::npos) {
+      path.remove_prefix(slash + 1);
+    }
+  }
+  return m_alternatives.empty() ||
+         std::any_of(m_alternatives.begin(), m_alternatives.end(), [path](const Sequence& ops) { return matches(ops, path); });
+}
+
+namespace path_check_detail {
+// the stat and error of each path of [first, last), see check_paths
+TABPARSE_INLINE void stat_all(const std::string_view* first, const std::string_view* last, PathKind kind, unsigned n_threads,
+                              std::vector<PathInfo>& infos, std::vector<int>& errors) {
+  const std::size_t n_paths = std::size_t(last - first);
+  infos.resize(n_paths);
+  errors.resize(n_paths);
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  std::size_t n_chunks = (n_paths + chunk_size - 1) / chunk_size;
+  n_threads = unsigned(std::min<std::size_t>(n_threads, n_chunks));
+  if (n_threads <= 1) {
+    stat_range(first, infos.data(), errors.data(), 0, n_paths, kind);
+  } else {
+    std::atomic<std::size_t> next{0};
+    auto work = [&] {
+      for (;;) {
+        std::size_t begin = next.fetch_add(chunk_size, std::memory_order_relaxed);
+        if (begin >= n_paths) {
+          return;
+        }
+        stat_range(first, infos.data(), errors.data(), begin, std::min(begin + chunk_size, n_paths), kind);
+      }
+    };
+    // the calling thread is one of the workers
+    std::vector<std::thread> threads;
+    threads.reserve(n_threads - 1);
+    for (unsigned i = 1; i < n_threads; ++i) {
+      threads.emplace_back(work);
+    }
+    work();
+    for (auto& thread : threads) {
+      thread.join();
+    }
+  }
+}
+}
+
+TABPARSE_INLINE std::vector<int> check_paths(const std::string_view* first, const std::string_view* last, PathKind kind,
+                                             unsigned n_threads, std::vector<PathInfo>& infos) {
+  std::vector<int> errors;
+  path_check_detail::stat_all(first, last, kind, n_threads, infos, errors);
+  return errors;
+}
+
+TABPARSE_INLINE std::vector<PathInfo> stat_paths(const std::string_view* first, const std::string_view* last, PathKind kind,
+                                                 unsigned n_threads) {
+  std::vector<PathInfo> infos;
+  std::vector<int> errors;
+  path_check_detail::stat_all(first, last, kind, n_threads, infos, errors);
+  auto failed = std::find_if(errors.begin(), errors.end(), [](int error) { return error != 0; });
+  if (failed != errors.end()) {
+    auto path = first[failed - errors.begin()];
+    if (*failed == path_wrong_kind && kind == PathKind::Directory) {
+      throw std::invalid_argument(fmt::format("{} is not a directory.", path));
+    }
+    if (*failed == path_wrong_kind) {
+      throw std::invalid_argument(fmt::format("{} is a directory.", path));
+    }
+    if (*failed == ENOENT) {
+      throw std::invalid_argument(fmt::format("{} does not exist.", path));
+    }
+    throw std::invalid_argument(fmt::format("can not stat {}: {}", path, std::generic_category().message(*failed)));
+  }
+  return infos;
+}
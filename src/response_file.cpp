@@ -0,0 +1,263 @@
+#include "response_file.h"
+#include "header_only.h"
+#include <cerrno>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace response_file_detail {
+// nested response files beyond this depth are most likely a cycle
+inline constexpr int max_depth = 16;
+
+TABPARSE_INLINE bool is_separator(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f' || c == '\v' || c == '\0';
+}
+
+// Finds the next token in [pos, end) and leaves pos on the character that
+// terminates it. Returns false if there is none. needs_unescape tells whether
+// the raw token contains quotes or backslashes.
+TABPARSE_INLINE bool scan_token(const char*& pos, const char* end, const char*& start, bool& needs_unescape) {
+  while (pos != end && is_separator(*pos)) {
+    ++pos;
+  }
+  if (pos == end) {
+    return false;
+  }
+  start = pos;
+  needs_unescape = false;
+  bool in_single = false;
+  bool in_double = false;
+  for (; pos != end; ++pos) {
+    char c = *pos;
+    if (in_single) {
+      in_single = c != '\'';
+    } else if (c == '\\') {
+      needs_unescape = true;
+      if (pos + 1 != end) {
+        ++pos;
+      }
+    } else if (in_double) {
+      in_double = c != '"';
+    } else if (c == '\'') {
+      in_single = needs_unescape = true;
+    } else if (c == '"') {
+      in_double = needs_unescape = true;
+    } else if (is_separator(c)) {
+      break;
+    }
+  }
+  return true;
+}
+
+// writes the token without its quoting to out, which may alias raw as the
+// result is never longer than the input
+TABPARSE_INLINE char* unescape(const char* raw, const char* raw_end, char* out) {
+  bool in_single = false;
+  bool in_double = false;
+  for (; raw != raw_end; ++raw) {
+    char c = *raw;
+    if (in_single) {
+      if (c == '\'') {
+        in_single = false;
+      } else {
+        *out++ = c;
+      }
+    } else if (c == '\\') {
+      if (raw + 1 != raw_end) {
+        *out++ = *++raw;
+      }
+    } else if (c == '\'' && !in_double) {
+      in_single = true;
+    } else if (c == '"') {
+      in_double = !in_double;
+    } else {
+      *out++ = c;
+    }
+  }
+  return out;
+}
+
+class FileDescriptor {
+  public:
+    explicit FileDescriptor(const std::string& path) : m_fd{::open(path.c_str(), O_RDONLY | O_CLOEXEC)} {
+      if (m_fd < 0) {
+        throw std::system_error(errno, std::generic_category(), fmt::format("could not open response file {}", path));
+      }
+    }
+    ~FileDescriptor() { ::close(m_fd); }
+    [[nodiscard]] std::size_t size() const {
+      struct stat st{};
+      if (::fstat(m_fd, &st) != 0) {
+        throw std::system_error(errno, std::generic_category(), "could not stat response file");
+      }
+      return std::size_t(st.st_size);
+    }
+    [[nodiscard]] int get() const { return m_fd; }
+  private:
+    int m_fd;
+};
+}
+
+TABPARSE_INLINE ResponseFile::ResponseFile(const std::string& path) {
+  response_file_detail::FileDescriptor fd{path};
+  auto size = fd.size();
+  if (size == 0) {
+    return;
+  }
+  // one byte more than the file, for the NUL after the last token. The file is
+  // mapped over an anonymous mapping such that this byte exists even when the
+  // file ends at a page boundary.
+  m_mapped = size + 1;
+  void* area = ::mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (area == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "could not map response file");
+  }
+  m_data = static_cast<char*>(area);
+  if (::mmap(m_data, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd.get(), 0) == MAP_FAILED) {
+    auto err = errno;
+    ::munmap(m_data, m_mapped);
+    throw std::system_error(err, std::generic_category(), "could not map response file");
+  }
+  ::madvise(m_data, size, MADV_SEQUENTIAL);
+
+  const char* pos = m_data;
+  const char* end = m_data + size;
+  const char* start;
+  bool needs_unescape;
+  while (response_file_detail::scan_token(pos, end, start, needs_unescape)) {
+    char* token = m_data + (start - m_data);
+    char* token_end = needs_unescape ? response_file_detail::unescape(start, pos, token) : m_data + (pos - m_data);
+    *token_end = '\0';
+    m_tokens.push_back(token);
+    if (pos != end) {
+      ++pos;
+    }
+  }
+}
+
+TABPARSE_INLINE ResponseFile::ResponseFile(ResponseFile&& other) noexcept
+    : m_data{std::exchange(other.m_data, nullptr)}, m_mapped{std::exchange(other.m_mapped, 0)},
+      m_tokens{std::move(other.m_tokens)} {}
+
+TABPARSE_INLINE ResponseFile& ResponseFile::operator=(ResponseFile&& other) noexcept {
+  std::swap(m_data, other.m_data);
+  std::swap(m_mapped, other.m_mapped);
+  std::swap(m_tokens, other.m_tokens);
+  return *this;
+}
+
+TABPARSE_INLINE ResponseFile::~ResponseFile() {
+  if (m_data) {
+    ::munmap(m_data, m_mapped);
+  }
+}
+
+TABPARSE_INLINE void ExpandedArgv::expand(int argc, const char* const* argv) {
+  m_files.clear();
+  m_argv.clear();
+  bool has_response_file = false;
+  for (int i = 0; i < argc; ++i) {
+    has_response_file = has_response_file || argv[i][0] == '@';
+  }
+  if (!has_response_file) {
+    m_begin = argv;
+    m_end = argv + argc;
+    return;
+  }
+  append(argc, argv, 0);
+  m_begin = m_argv.data();
+  m_end = m_argv.data() + m_argv.size();
+}
+
+TABPARSE_INLINE void ExpandedArgv::append(int argc, const char* const* argv, int depth) {
+  for (int i = 0; i < argc; ++i) {
+    const char* token = argv[i];
+    if (token[0] != '@' || ::access(token + 1, R_OK) != 0) {
+      m_argv.push_back(token);
+      continue;
+    }
+    if (depth == response_file_detail::max_depth) {
+      throw std::invalid_argument(fmt::format("response files nested too deeply at {}.", token));
+    }
+    // the tokens live in the mapping, moving the ResponseFile keeps them valid
+    m_files.emplace_back(std::string{token + 1});
+    const auto& tokens = m_files.back().tokens();
+    append(int(tokens.size()), tokens.data(), depth + 1);
+  }
+}
+
+TABPARSE_INLINE void stream_response_file(const std::string& path, std::size_t chunk_size,
+                          const std::function<void(const std::vector<std::string_view>&)>& on_chunk) {
+  response_file_detail::FileDescriptor fd{path};
+  auto size = fd.size();
+  if (size == 0) {
+    return;
+  }
+  void* area = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+  if (area == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(), "could not map response file");
+  }
+  const char* data = static_cast<const char*>(area);
+  ::madvise(area, size, MADV_SEQUENTIAL);
+  const auto page = std::size_t(::sysconf(_SC_PAGESIZE));
+
+  std::vector<std::string_view> chunk;
+  chunk.reserve(chunk_size);
+  // unescaped tokens of the current chunk, the views into it are only made
+  // once the chunk is complete as the buffer may move while it grows
+  std::vector<char> unescaped;
+  std::vector<std::pair<std::size_t, std::size_t>> unescaped_tokens;
+  std::size_t released = 0;
+
+  auto flush = [&](const char* pos) {
+    for (auto [index, offset] : unescaped_tokens) {
+      auto length = chunk[index].size();
+      chunk[index] = std::string_view{unescaped.data() + offset, length};
+    }
+    on_chunk(chunk);
+    chunk.clear();
+    unescaped.clear();
+    unescaped_tokens.clear();
+    // everything before pos has been handed out and is not needed again
+    auto done = (std::size_t(pos - data) / page) * page;
+    if (done > released) {
+      ::madvise(const_cast<char*>(data) + released, done - released, MADV_DONTNEED);
+      released = done;
+    }
+  };
+
+  try {
+    const char* pos = data;
+    const char* end = data + size;
+    const char* start;
+    bool needs_unescape;
+    while (response_file_detail::scan_token(pos, end, start, needs_unescape)) {
+      if (needs_unescape) {
+        auto offset = unescaped.size();
+        unescaped.resize(offset + std::size_t(pos - start));
+        auto* out_end = response_file_detail::unescape(start, pos, unescaped.data() + offset);
+        unescaped.resize(std::size_t(out_end - unescaped.data()));
+        unescaped_tokens.emplace_back(chunk.size(), offset);
+        // placeholder with the right length, pointed at the buffer in flush
+        chunk.emplace_back(start, unescaped.size() - offset);
+      } else {
+        chunk.emplace_back(start, std::size_t(pos - start));
+      }
+      if (chunk.size() == chunk_size) {
+        flush(pos);
+      }
+    }
+    if (!chunk.empty()) {
+      flush(end);
+    }
+  } catch (...) {
+    ::munmap(area, size);
+    throw;
+  }
+  ::munmap(area, size);
+}
@@ -1,120 +1,15 @@
 #include "v_opt.h"
-#include <cstdlib>
+#include "header_only.h"
 #include <fmt/format.h>
-#include <algorithm>
-#include <memory>
 
-ArgIter IntArg::parse(ArgIter iter) {
-  m_flags.set(ArgFlags::Present);
-  char* end;
-  m_storage = int(strtol(&*(*iter).begin(),&end,0));
-  if (&*(*iter).end()!=end) {
-    throw std::invalid_argument(fmt::format("could not parse {} as integer.", *iter));
-  }
-  return ++iter;
-}
-
-template <typename FINAL_ARG>
-ArgIter StringArgBase<FINAL_ARG>::parse(ArgIter iter) {
-  ArgBase::m_flags.set(ArgFlags::Present);
-  TemplateArg<std::string, FINAL_ARG>::m_storage = *iter;
-  return ++iter;
-}
-
-ArgIter SwitchArg::parse(ArgIter iter) {
-  m_flags.set(ArgFlags::Present);
-  m_storage = true;
-  return iter;
-}
-
-std::string IntArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  retval += ":" + m_shortdoc + ":";
-  return retval;
-}
-
-std::string FileArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  retval += ":" + m_shortdoc + ":";
-  retval += " _files -g '" + m_pattern + "'";
-  return retval;
-}
-
-std::string DirectoryArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  retval += ":" + m_shortdoc + ":";
-  retval += " _files -/";
-  return retval;
-}
-
-std::string StringArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  retval += ":" + m_shortdoc + ":";
-  return retval;
+TABPARSE_INLINE void SwitchArg::completion_entry(fmt::memory_buffer& out, bool skip_description, std::size_t /*unused*/) const {
+  completion_prefix(out, skip_description, false);
 }
 
-std::string StringChoiceArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  retval += ":" + m_shortdoc + ":";
-  if (m_descriptions.empty()) {
-    retval += "(";
-    for (size_t i = 0; i < m_choices.size() - 1; ++i) {
-      retval += m_choices[i] + " ";
-    }
-    retval += m_choices.back() + ")";
-  } else {
-    retval += "((";
-    for (size_t i = 0; i < m_choices.size() - 1; ++i) {
-      retval += m_choices[i] + "\\:'" + m_descriptions[i] + "' ";
+TABPARSE_INLINE void ArgBase::validate_all(ArgIter first, ArgIter last, std::pmr::vector<Diagnostic>& out) const {
+  for (; first != last; ++first) {
+    if (auto problem = validate(*first)) {
+      out.push_back({*problem, DiagnosticSource::CommandLine, this, *first});
     }
-    retval += m_choices.back() + "\\:'" + m_descriptions.back() + "'";
-    retval += "))";
   }
-  return retval;
 }
-
-std::string SwitchArg::completion_entry(bool skip_description) {
-  std::string retval;
-  retval += m_name;
-  if (!skip_description) {
-    retval += "[" + m_doc + "]";
-  }
-  return retval;
-}
-
-ArgIter StringChoiceArg::parse(ArgIter iter) {
-  iter = StringArgBase<StringChoiceArg>::parse(iter);
-  if (m_choices.end() == std::find(m_choices.begin(), m_choices.end(), TemplateArg<std::string, StringChoiceArg>::m_storage)) {
-    throw std::invalid_argument(fmt::format("{} is not a valid choice for {}.", m_storage, m_name));
-  }
-  return ++iter;
-}
-
-// template <typename BASE_ARG>
-// ArgIter MultiArg<BASE_ARG>::parse(ArgIter iter, ArgIter end) {
-//   for (; iter != end;) {
-//     iter = BASE_ARG::parse(iter);
-//     m_allvals.push_back(BASE_ARG::m_storage);
-//   }
-//   return iter;
-// }